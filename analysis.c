@@ -0,0 +1,453 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include "analysis.h"
+
+static const char *protocol_names[ANALYSIS_PROTOCOLS] = {"PCP", "PIP", "none"};
+
+static int64_t ns(const struct timespec *t)
+{
+  return (int64_t)t->tv_sec * 1000000000 + t->tv_nsec;
+}
+
+// Tasks that can preempt each other (same CPU, or not partitioned)
+static int same_cpu(const struct periodic_data *a, const struct periodic_data *b)
+{
+  return a->cpu < 0 || b->cpu < 0 || a->cpu == b->cpu;
+}
+
+// Longest critical section of task d on every resource (cs[k] for R(k+1)),
+// measured from the lock to the matching unlock, nested sections included,
+// and number of times each resource is locked per job (nlocks[k])
+static void critical_sections(const struct periodic_data *d, int nresources,
+                              int64_t *cs, int *nlocks)
+{
+  int i, k;
+
+  memset(cs, 0, nresources * sizeof(int64_t));
+  memset(nlocks, 0, nresources * sizeof(int));
+  for (i = 0; i < d->nsegments; i++)
+  {
+    int64_t len = 0;
+    int r = d->segments[i].resource;
+
+    if (d->segments[i].kind != SEGMENT_LOCK)
+      continue;
+    for (k = i + 1; k < d->nsegments; k++)
+    {
+      if (d->segments[k].kind == SEGMENT_COMPUTE)
+        len += ns(&d->segments[k].time);
+      else if (d->segments[k].kind == SEGMENT_UNLOCK && d->segments[k].resource == r)
+        break;
+    }
+    if (len > cs[r - 1])
+      cs[r - 1] = len;
+    nlocks[r - 1]++;
+  }
+}
+
+// Resources that take part in a cycle of the lock-order graph (an edge
+// a->b means some job locks b while holding a)
+static void lock_order_cycles(const struct task_set *ts, char *in_cycle)
+{
+  int m = ts->nresources;
+  char *reach = calloc(m * m, 1);
+  char held[m + 1];
+  int i, j, k;
+
+  for (i = 0; i < ts->ntasks; i++)
+  {
+    const struct periodic_data *d = &ts->tasks[i];
+
+    memset(held, 0, m);
+    for (k = 0; k < d->nsegments; k++)
+    {
+      int r = d->segments[k].resource - 1;
+
+      if (d->segments[k].kind == SEGMENT_LOCK)
+      {
+        for (j = 0; j < m; j++)
+        {
+          if (held[j])
+            reach[j * m + r] = 1;
+        }
+        held[r] = 1;
+      }
+      else if (d->segments[k].kind == SEGMENT_UNLOCK)
+      {
+        held[r] = 0;
+      }
+    }
+  }
+
+  // Transitive closure (Warshall)
+  for (k = 0; k < m; k++)
+    for (i = 0; i < m; i++)
+      if (reach[i * m + k])
+        for (j = 0; j < m; j++)
+          if (reach[k * m + j])
+            reach[i * m + j] = 1;
+
+  for (i = 0; i < m; i++)
+    in_cycle[i] = reach[i * m + i];
+  free(reach);
+}
+
+// Release jitter of the interference of task j under protocol p. Without
+// a protocol a blocked task suspends and lets lower-priority tasks run, so
+// its execution can be deferred by up to R_j - C_j and hit them twice in
+// less than a period; with PCP and PIP the owner runs at its priority
+// instead. Needs wcrt[p] of the higher-priority tasks
+static int64_t jitter(const struct analysis *a, int j, analysis_protocol p)
+{
+  const struct analysis_result *t = &a->tasks[j];
+
+  if (p != ANALYSIS_NONE || t->blocking[p] == 0)
+    return 0;
+  if (t->wcrt[p] == ANALYSIS_UNBOUNDED)
+    return ANALYSIS_UNBOUNDED;
+  return t->wcrt[p] - t->wcet;
+}
+
+// Iterate R = C + B + sum ceil((R + Jj)/Tj) Cj over the tasks of priority
+// >= d's
+static int64_t response_time(const struct task_set *ts, const struct analysis *a,
+                             int i, analysis_protocol p)
+{
+  const struct periodic_data *d = &ts->tasks[i];
+  int64_t deadline = ns(&d->deadline);
+  int64_t blocking = a->tasks[i].blocking[p];
+  int64_t r, next = a->tasks[i].wcet + blocking;
+  int j;
+
+  if (blocking == ANALYSIS_UNBOUNDED)
+    return ANALYSIS_UNBOUNDED;
+  for (j = 0; j < ts->ntasks; j++)
+  {
+    if (j != i && ts->tasks[j].prio >= d->prio && same_cpu(d, &ts->tasks[j]) &&
+        jitter(a, j, p) == ANALYSIS_UNBOUNDED)
+      return ANALYSIS_UNBOUNDED;
+  }
+  do
+  {
+    r = next;
+    if (r > deadline)
+      return ANALYSIS_UNBOUNDED;
+    next = a->tasks[i].wcet + blocking;
+    for (j = 0; j < ts->ntasks; j++)
+    {
+      int64_t tj = ns(&ts->tasks[j].period);
+
+      if (j == i || ts->tasks[j].prio < d->prio || !same_cpu(d, &ts->tasks[j]))
+        continue;
+      next += ((r + jitter(a, j, p) + tj - 1) / tj) * a->tasks[j].wcet;
+    }
+  } while (next != r);
+  return r;
+}
+
+// qsort helper: order task pointers by decreasing priority
+static int by_priority(const void *a, const void *b)
+{
+  const struct periodic_data *da = *(struct periodic_data *const *)a;
+  const struct periodic_data *db = *(struct periodic_data *const *)b;
+
+  return db->prio - da->prio;
+}
+
+// MPCP blocking of task i on global resources (0 when nothing is global):
+//  - every request to a global resource waits for at most one critical
+//    section of a lower-priority task and one of every higher-priority
+//    task of another CPU;
+//  - global critical sections of lower-priority tasks of the same CPU run
+//    above every task priority and preempt i once per lock
+static int64_t mpcp_blocking(const struct task_set *ts, const int64_t *cs,
+                             const int *nlocks, int i)
+{
+  const struct periodic_data *d = &ts->tasks[i];
+  int n = ts->ntasks, m = ts->nresources;
+  int64_t b = 0;
+  int j, k;
+
+  for (k = 0; k < m; k++)
+  {
+    int64_t lower = 0, higher = 0;
+
+    if (!ts->resources[k].global)
+      continue;
+    for (j = 0; j < n; j++)
+    {
+      const struct periodic_data *o = &ts->tasks[j];
+
+      if (j == i || cs[j * m + k] == 0)
+        continue;
+      if (o->prio < d->prio && cs[j * m + k] > lower)
+        lower = cs[j * m + k];
+      if (o->prio >= d->prio && o->cpu != d->cpu)
+        higher += cs[j * m + k];
+      if (o->prio < d->prio && o->cpu == d->cpu)
+        b += nlocks[j * m + k] * cs[j * m + k];
+    }
+    b += nlocks[i * m + k] * (lower + higher);
+  }
+  return b;
+}
+
+int analysis_run(const struct task_set *ts, struct analysis *a)
+{
+  int n = ts->ntasks, m = ts->nresources;
+  int64_t *cs = calloc((size_t)n * (m ? m : 1), sizeof(int64_t));
+  int *nlocks = calloc((size_t)n * (m ? m : 1), sizeof(int));
+  const struct periodic_data **order = malloc(n * sizeof(*order));
+  char in_cycle[m + 1];
+  char checked[n + 1];
+  int i, j, k;
+
+  memset(a, 0, sizeof(*a));
+  a->ntasks = n;
+  a->nresources = m;
+  a->tasks = calloc(n, sizeof(struct analysis_result));
+  a->ceiling = calloc(m ? m : 1, sizeof(int));
+  if (cs == NULL || nlocks == NULL || order == NULL || a->tasks == NULL ||
+      a->ceiling == NULL)
+  {
+    free(cs);
+    free(nlocks);
+    free(order);
+    analysis_free(a);
+    return -1;
+  }
+
+  // Execution times and critical sections; the ceilings are those of the
+  // resources (taskset_compute_ceilings)
+  for (i = 0; i < n; i++)
+  {
+    const struct periodic_data *d = &ts->tasks[i];
+    struct timespec c = taskset_wcet(d);
+
+    a->tasks[i].wcet = ns(&c);
+    a->utilization += (double)a->tasks[i].wcet / ns(&d->period);
+    critical_sections(d, m, &cs[i * m], &nlocks[i * m]);
+  }
+  for (k = 0; k < m; k++)
+  {
+    a->ceiling[k] = ts->resources[k].ceiling;
+  }
+  lock_order_cycles(ts, in_cycle);
+  for (k = 0; k < m; k++)
+  {
+    a->deadlock_possible |= in_cycle[k];
+  }
+
+  for (i = 0; i < n; i++)
+  {
+    const struct periodic_data *d = &ts->tasks[i];
+    int prio = d->prio;
+    int64_t pcp = 0, by_task = 0, by_resource = 0, direct = 0;
+    int inversion = 0, deadlock = 0;
+
+    memset(checked, 0, sizeof(checked));
+    // PCP blocks once, for the longest lower-priority critical section on a
+    // resource whose ceiling is >= prio; PIP takes the smaller of the
+    // per-task and per-resource sums of those sections. Only tasks of the
+    // same CPU and local resources count here
+    for (j = 0; j < n; j++)
+    {
+      int64_t longest = 0;
+
+      if (ts->tasks[j].prio >= prio || !same_cpu(d, &ts->tasks[j]))
+        continue;
+      for (k = 0; k < m; k++)
+      {
+        if (!ts->resources[k].global && a->ceiling[k] >= prio && cs[j * m + k] > longest)
+          longest = cs[j * m + k];
+      }
+      if (longest > pcp)
+        pcp = longest;
+      by_task += longest;
+    }
+    for (k = 0; k < m; k++)
+    {
+      int64_t longest = 0, shared = 0;
+      int l;
+
+      if (a->ceiling[k] < prio || ts->resources[k].global)
+        continue;
+      for (j = 0; j < n; j++)
+      {
+        if (ts->tasks[j].prio >= prio || cs[j * m + k] == 0 || !same_cpu(d, &ts->tasks[j]))
+          continue;
+        if (cs[j * m + k] > longest)
+          longest = cs[j * m + k];
+
+        // Without a protocol, a task of intermediate priority can preempt
+        // the lower-priority owner of a resource we use for an unbounded
+        // time. That only depends on i and j, so every j is looked at once
+        if (cs[i * m + k] > 0)
+        {
+          if (cs[j * m + k] > shared)
+            shared = cs[j * m + k];
+          if (!inversion && !checked[j])
+          {
+            checked[j] = 1;
+            for (l = 0; l < n && !inversion; l++)
+            {
+              if (ts->tasks[l].prio > ts->tasks[j].prio && ts->tasks[l].prio < prio &&
+                  same_cpu(&ts->tasks[l], &ts->tasks[j]))
+                inversion = 1;
+            }
+          }
+        }
+      }
+      by_resource += longest;
+      direct += shared;
+      if (in_cycle[k] && cs[i * m + k] > 0)
+        deadlock = 1;
+    }
+
+    a->tasks[i].blocking[ANALYSIS_PCP] = pcp + mpcp_blocking(ts, cs, nlocks, i);
+    a->tasks[i].blocking[ANALYSIS_PIP] = by_task < by_resource ? by_task : by_resource;
+    a->tasks[i].blocking[ANALYSIS_NONE] = inversion ? ANALYSIS_UNBOUNDED : direct;
+    if (deadlock)
+    {
+      a->tasks[i].blocking[ANALYSIS_PIP] = ANALYSIS_UNBOUNDED;
+      a->tasks[i].blocking[ANALYSIS_NONE] = ANALYSIS_UNBOUNDED;
+    }
+  }
+
+  // Highest priorities first, so that the jitter of the tasks above is
+  // known; unknown ones (equal priority, not yet computed) are unbounded
+  for (i = 0; i < n; i++)
+  {
+    order[i] = &ts->tasks[i];
+    for (k = 0; k < ANALYSIS_PROTOCOLS; k++)
+      a->tasks[i].wcrt[k] = ANALYSIS_UNBOUNDED;
+  }
+  qsort(order, n, sizeof(*order), by_priority);
+  for (i = 0; i < n; i++)
+  {
+    j = order[i] - ts->tasks;
+    for (k = 0; k < ANALYSIS_PROTOCOLS; k++)
+    {
+      a->tasks[j].wcrt[k] = response_time(ts, a, j, (analysis_protocol)k);
+    }
+  }
+
+  free(order);
+  free(cs);
+  free(nlocks);
+  return 0;
+}
+
+int analysis_parse_protocol(const char *name, analysis_protocol *p)
+{
+  int k;
+
+  for (k = 0; k < ANALYSIS_PROTOCOLS; k++)
+  {
+    if (strcasecmp(name, protocol_names[k]) == 0)
+    {
+      *p = (analysis_protocol)k;
+      return 0;
+    }
+  }
+  return -1;
+}
+
+const char *analysis_protocol_name(analysis_protocol p)
+{
+  return protocol_names[p];
+}
+
+int analysis_schedulable(const struct analysis *a, analysis_protocol p)
+{
+  int i;
+
+  for (i = 0; i < a->ntasks; i++)
+  {
+    if (a->tasks[i].wcrt[p] == ANALYSIS_UNBOUNDED)
+      return 0;
+  }
+  return 1;
+}
+
+// Print a time in seconds, or a marker if there is no bound
+static void print_time(int64_t t, const char *unbounded)
+{
+  if (t == ANALYSIS_UNBOUNDED)
+    printf(" %8s", unbounded);
+  else
+    printf(" %8.3f", t / 1.0e9);
+}
+
+void analysis_print(const struct task_set *ts, const struct analysis *a,
+                    analysis_protocol active)
+{
+  int i, k;
+
+  printf("Response-time analysis: U = %.3f, %d tasks, %d resources\n",
+         a->utilization, a->ntasks, a->nresources);
+  if (a->nresources > 0)
+  {
+    printf("Ceilings:");
+    for (k = 0; k < a->nresources; k++)
+      printf(" R%d=%d", k + 1, a->ceiling[k]);
+    printf("\n");
+  }
+  if (a->deadlock_possible)
+    printf("Warning: lock orders form a cycle, deadlock is possible without PCP\n");
+
+  printf("  Task Prio        C        T        D");
+  for (k = 0; k < ANALYSIS_PROTOCOLS; k++)
+  {
+    char b[16], r[16];
+
+    sprintf(b, "B(%s)", protocol_names[k]);
+    sprintf(r, "R(%s)", protocol_names[k]);
+    printf(" |%c%8s %8s", k == (int)active ? '*' : ' ', b, r);
+  }
+  printf("\n");
+
+  for (i = 0; i < a->ntasks; i++)
+  {
+    const struct periodic_data *d = &ts->tasks[i];
+
+    printf("  %4d %4d", d->id, d->prio);
+    print_time(a->tasks[i].wcet, "");
+    print_time(ns(&d->period), "");
+    print_time(ns(&d->deadline), "");
+    for (k = 0; k < ANALYSIS_PROTOCOLS; k++)
+    {
+      printf(" |");
+      print_time(a->tasks[i].blocking[k], "inf");
+      print_time(a->tasks[i].wcrt[k], "> D");
+    }
+    printf("\n");
+  }
+  printf("Schedulable under %s: %s\n", protocol_names[active],
+         analysis_schedulable(a, active) ? "yes" : "NO");
+}
+
+void analysis_print_measured(const struct task_set *ts, const struct analysis *a,
+                             analysis_protocol p)
+{
+  int i;
+
+  printf("  Task   measured   R(%s)\n", protocol_names[p]);
+  for (i = 0; i < a->ntasks; i++)
+  {
+    const struct periodic_data *d = &ts->tasks[i];
+
+    printf("  %4d   %8.3f", d->id, ns(&d->wcrt) / 1.0e9);
+    print_time(a->tasks[i].wcrt[p], "> D");
+    printf("\n");
+  }
+}
+
+void analysis_free(struct analysis *a)
+{
+  free(a->tasks);
+  free(a->ceiling);
+  memset(a, 0, sizeof(*a));
+}
@@ -0,0 +1,76 @@
+#ifndef _ANALYSIS_H
+#define _ANALYSIS_H
+
+#include <stdint.h>
+#include "taskset.h"
+
+/**
+ * @file analysis.h
+ *
+ * Offline response-time analysis of a task set under fixed priorities.
+ * Blocking terms are derived from the job bodies for the immediate
+ * priority ceiling protocol (PTHREAD_PRIO_PROTECT), priority inheritance
+ * (PTHREAD_PRIO_INHERIT) and plain mutexes, and then plugged into the
+ * classic iterative response-time equation
+ *
+ *     R = C + B + sum_{j in hp(i)} ceil(R / T_j) * C_j
+ *
+ * When the tasks are partitioned (cpu >= 0), hp(i) and local blocking
+ * only include tasks of the same CPU, and the PCP column adds the MPCP
+ * remote blocking on global resources. The PIP and no-protocol columns
+ * then ignore global resources.
+ **/
+
+typedef enum
+{
+  ANALYSIS_PCP,  // immediate priority ceiling (PTHREAD_PRIO_PROTECT)
+  ANALYSIS_PIP,  // priority inheritance (PTHREAD_PRIO_INHERIT)
+  ANALYSIS_NONE, // no protocol
+  ANALYSIS_PROTOCOLS
+} analysis_protocol;
+
+// Blocking or response time that has no bound
+#define ANALYSIS_UNBOUNDED INT64_MAX
+
+// Per-task results, in nanoseconds
+struct analysis_result
+{
+  int64_t wcet;                         // C
+  int64_t blocking[ANALYSIS_PROTOCOLS]; // B
+  int64_t wcrt[ANALYSIS_PROTOCOLS];     // R, ANALYSIS_UNBOUNDED if > deadline
+};
+
+struct analysis
+{
+  int ntasks;
+  struct analysis_result *tasks; // same order as task_set.tasks
+  int nresources;
+  int *ceiling;          // ceiling[k] is the priority ceiling of R(k+1)
+  double utilization;    // sum of C/T
+  int deadlock_possible; // lock orders form a cycle (deadlock without PCP)
+};
+
+// Parse "pcp", "pip" or "none"; -1 if unknown
+extern int analysis_parse_protocol(const char *name, analysis_protocol *p);
+
+// Name of protocol p as printed in the tables ("PCP", "PIP", "none")
+extern const char *analysis_protocol_name(analysis_protocol p);
+
+// Analyse ts (priorities must already be assigned)
+extern int analysis_run(const struct task_set *ts, struct analysis *a);
+
+// 1 if every task meets its deadline under protocol p
+extern int analysis_schedulable(const struct analysis *a, analysis_protocol p);
+
+// Print ceilings, blocking terms and bounds for all protocols
+extern void analysis_print(const struct task_set *ts, const struct analysis *a,
+                           analysis_protocol active);
+
+// Print the measured worst-case response times next to the bounds of p
+extern void analysis_print_measured(const struct task_set *ts,
+                                    const struct analysis *a,
+                                    analysis_protocol p);
+
+extern void analysis_free(struct analysis *a);
+
+#endif
@@ -0,0 +1,350 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/timerfd.h>
+#include "timespec_operations.h"
+#include "dispatch.h"
+#include "partition.h"
+#include "rtinit.h"
+#include "stats.h"
+
+struct dispatch_worker;
+
+// Release state of one task
+struct dispatch_task
+{
+  struct periodic_data *d;
+  struct dispatch_worker *worker;
+  struct timespec next;       // next release, key of the heap
+  struct timespec oldest;     // release of the oldest pending job
+  int pending;                // released jobs not completed, the running one included
+  struct dispatch_task *link; // next task in the ready queue of its worker
+};
+
+// Worker of one priority level and CPU. The ready queue holds the tasks
+// with pending jobs in release order, each once: the worker runs all the
+// pending jobs of a task back to back, as its own thread would
+struct dispatch_worker
+{
+  int prio;
+  int cpu;
+  pthread_mutex_t lock; // priority inheritance: the timer thread takes it too
+  pthread_cond_t ready;
+  struct dispatch_task *head, *tail;
+  int done;             // the timer thread has returned
+  _Atomic(struct periodic_data *) running;
+};
+
+static struct dispatch_config config;
+static struct dispatch_task *tasks;
+static int ntasks;
+static struct dispatch_worker *workers;
+static int nworkers;
+static int timer_prio;
+static int timer_fd = -1;
+
+// Min-heap of the tasks by next release; tasks whose next release is at
+// or after the end of a bounded run leave it
+static struct dispatch_task **heap;
+static int nheap;
+
+static int earlier(const struct dispatch_task *a, const struct dispatch_task *b)
+{
+  return smaller_timespec(&a->next, &b->next);
+}
+
+static void sift_down(int i)
+{
+  struct dispatch_task *t = heap[i];
+
+  while (2 * i + 1 < nheap)
+  {
+    int c = 2 * i + 1;
+
+    if (c + 1 < nheap && earlier(heap[c + 1], heap[c]))
+      c++;
+    if (!earlier(heap[c], t))
+      break;
+    heap[i] = heap[c];
+    i = c;
+  }
+  heap[i] = t;
+}
+
+static void heap_push(struct dispatch_task *t)
+{
+  int i = nheap++;
+
+  while (i > 0 && earlier(t, heap[(i - 1) / 2]))
+  {
+    heap[i] = heap[(i - 1) / 2];
+    i = (i - 1) / 2;
+  }
+  heap[i] = t;
+}
+
+static void heap_pop(void)
+{
+  heap[0] = heap[--nheap];
+  if (nheap > 0)
+    sift_down(0);
+}
+
+// Queue the job of t released at t->next to its worker
+static void release(struct dispatch_task *t)
+{
+  struct dispatch_worker *w = t->worker;
+
+  pthread_mutex_lock(&w->lock);
+  if (config.overrun == OVERRUN_SKIP && t->pending > 0)
+  {
+    // The previous job is still running: this release is already late
+    if (!smaller_timespec(&t->next, &config.measure))
+      stats_count(&t->d->stats->skipped, 1);
+  }
+  else if (t->pending++ == 0)
+  {
+    t->oldest = t->next;
+    t->link = NULL;
+    if (w->tail != NULL)
+      w->tail->link = t;
+    else
+      w->head = t;
+    w->tail = t;
+    pthread_cond_signal(&w->ready);
+  }
+  pthread_mutex_unlock(&w->lock);
+}
+
+// Body of the timer thread: sleep until the earliest release, queue every
+// job already due and move each task to its next release
+static void *timer(void *arg)
+{
+  struct itimerspec its;
+  struct timespec now;
+  uint64_t expirations;
+  int i;
+
+  (void)arg;
+  rt_prefault_stack();
+  pthread_barrier_wait(config.barrier);
+  memset(&its, 0, sizeof(its));
+
+  while (nheap > 0 && !atomic_load(config.stopping))
+  {
+    its.it_value = heap[0]->next;
+    if (timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &its, NULL) != 0)
+    {
+      perror("timerfd_settime");
+      exit(1);
+    }
+    // Interrupted when the run is stopped
+    if (read(timer_fd, &expirations, sizeof(expirations)) < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      perror("timerfd");
+      exit(1);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    while (nheap > 0 && smaller_or_equal_timespec(&heap[0]->next, &now))
+    {
+      struct dispatch_task *t = heap[0];
+
+      release(t);
+      incr_timespec(&t->next, &t->d->period);
+      if (config.bounded && !smaller_timespec(&t->next, &config.end))
+        heap_pop();
+      else
+        sift_down(0);
+    }
+  }
+
+  // No more releases: the workers return once their queue is empty
+  for (i = 0; i < nworkers; i++)
+  {
+    pthread_mutex_lock(&workers[i].lock);
+    workers[i].done = 1;
+    pthread_cond_broadcast(&workers[i].ready);
+    pthread_mutex_unlock(&workers[i].lock);
+  }
+  return NULL;
+}
+
+// Body of a worker: run the pending jobs of its tasks in release order
+static void *worker(void *arg)
+{
+  struct dispatch_worker *w = arg;
+  struct timespec release, end;
+  struct dispatch_task *t;
+
+  rt_prefault_stack();
+  pthread_barrier_wait(config.barrier);
+
+  pthread_mutex_lock(&w->lock);
+  while (1)
+  {
+    while (w->head == NULL && !w->done)
+      pthread_cond_wait(&w->ready, &w->lock);
+    if (w->head == NULL || atomic_load(config.stopping))
+      break;
+    t = w->head;
+    w->head = t->link;
+    if (w->head == NULL)
+      w->tail = NULL;
+
+    // Late jobs (catch-up) are run back to back; releases arriving
+    // meanwhile only add to pending
+    while (t->pending > 0 && !atomic_load(config.stopping))
+    {
+      release = t->oldest;
+      pthread_mutex_unlock(&w->lock);
+      atomic_store(&w->running, t->d);
+      config.job(t->d, &release, &end);
+      atomic_store(&w->running, NULL);
+      pthread_mutex_lock(&w->lock);
+      t->pending--;
+      incr_timespec(&t->oldest, &t->d->period);
+    }
+  }
+  pthread_mutex_unlock(&w->lock);
+  return NULL;
+}
+
+int dispatch_init(struct task_set *ts, const struct dispatch_config *cfg)
+{
+  pthread_mutexattr_t mutexattr;
+  int i, k;
+
+  config = *cfg;
+  ntasks = ts->ntasks;
+  tasks = calloc(ntasks, sizeof(struct dispatch_task));
+  workers = calloc(ntasks, sizeof(struct dispatch_worker));
+  heap = calloc(ntasks, sizeof(struct dispatch_task *));
+  if (tasks == NULL || workers == NULL || heap == NULL)
+    return -1;
+
+  // Above every task and every ceiling (MPCP puts the global ones above
+  // the tasks), so that a critical section never delays a release
+  timer_prio = taskset_max_prio(ts);
+  for (k = 0; k < ts->nresources; k++)
+  {
+    if (ts->resources[k].ceiling > timer_prio)
+      timer_prio = ts->resources[k].ceiling;
+  }
+  timer_prio += cfg->min_prio + 1;
+
+  pthread_mutexattr_init(&mutexattr);
+  pthread_mutexattr_setprotocol(&mutexattr, PTHREAD_PRIO_INHERIT);
+  for (i = 0; i < ntasks; i++)
+  {
+    struct dispatch_task *t = &tasks[i];
+
+    t->d = &ts->tasks[i];
+    for (k = 0; k < nworkers; k++)
+    {
+      if (workers[k].prio == t->d->prio && workers[k].cpu == t->d->cpu)
+        break;
+    }
+    if (k == nworkers)
+    {
+      workers[k].prio = t->d->prio;
+      workers[k].cpu = t->d->cpu;
+      pthread_mutex_init(&workers[k].lock, &mutexattr);
+      pthread_cond_init(&workers[k].ready, NULL);
+      atomic_init(&workers[k].running, NULL);
+      nworkers++;
+    }
+    t->worker = &workers[k];
+
+    add_timespec(&t->next, &cfg->start, &t->d->phase);
+    if (!cfg->bounded || smaller_timespec(&t->next, &cfg->end))
+      heap_push(t);
+  }
+  pthread_mutexattr_destroy(&mutexattr);
+
+  timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+  if (timer_fd < 0)
+  {
+    perror("timerfd_create");
+    return -1;
+  }
+  return nworkers + 1;
+}
+
+// Create one thread with attr at SCHED_FIFO priority prio on cpu
+static int create(pthread_attr_t *attr, pthread_t *th, int prio, int cpu,
+                  void *(*body)(void *), void *arg)
+{
+  struct sched_param sch_param;
+
+  sch_param.sched_priority = prio;
+  if (pthread_attr_setschedparam(attr, &sch_param) != 0 ||
+      partition_set_affinity(attr, cpu) != 0)
+    return -1;
+  return pthread_create(th, attr, body, arg);
+}
+
+int dispatch_start(pthread_attr_t *attr, pthread_t *threads)
+{
+  int i;
+
+  if (create(attr, &threads[0], timer_prio, -1, timer, NULL) != 0)
+    return -1;
+  for (i = 0; i < nworkers; i++)
+  {
+    if (create(attr, &threads[i + 1], config.min_prio + workers[i].prio, workers[i].cpu,
+               worker, &workers[i]) != 0)
+      return -1;
+  }
+  return 0;
+}
+
+struct periodic_data *dispatch_running(int i)
+{
+  return i == 0 ? NULL : atomic_load(&workers[i - 1].running);
+}
+
+void dispatch_print_queued(FILE *f, int i)
+{
+  struct dispatch_worker *w;
+  struct dispatch_task *t;
+
+  if (i == 0)
+    return;
+  w = &workers[i - 1];
+  pthread_mutex_lock(&w->lock);
+  if (w->head != NULL)
+  {
+    fprintf(f, "  Stalled behind it (priority %d):", w->prio);
+    for (t = w->head; t != NULL; t = t->link)
+      fprintf(f, " %d", t->d->id);
+    fprintf(f, "\n");
+  }
+  pthread_mutex_unlock(&w->lock);
+}
+
+void dispatch_print(FILE *f)
+{
+  int i, k;
+
+  fprintf(f, "Dispatcher: %d tasks, %d workers, timer at priority %d\n", ntasks, nworkers,
+          timer_prio - config.min_prio);
+  for (k = 0; k < nworkers; k++)
+  {
+    fprintf(f, "  Worker %d (priority %d", k + 1, workers[k].prio);
+    if (workers[k].cpu >= 0)
+      fprintf(f, ", CPU %d", workers[k].cpu);
+    fprintf(f, "):");
+    for (i = 0; i < ntasks; i++)
+    {
+      if (tasks[i].worker == &workers[k])
+        fprintf(f, " %d", tasks[i].d->id);
+    }
+    fprintf(f, "\n");
+  }
+}
@@ -0,0 +1,70 @@
+#ifndef _DISPATCH_H
+#define _DISPATCH_H
+
+#include <stdio.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include "taskset.h"
+
+/**
+ * @file dispatch.h
+ *
+ * Job-level dispatcher. Instead of one thread and one timer per task, a
+ * single timer thread keeps the next release of every task in a min-heap
+ * and sleeps on a timerfd armed for the earliest one; each release is
+ * queued to the worker thread of the task's priority level (and CPU, in
+ * partitioned mode), which runs the jobs of its level in release order.
+ * The kernel still preempts one level with another, so as long as no job
+ * blocks the schedule is the same as with a thread per task, while large
+ * task sets only need a thread per priority level.
+ *
+ * A job that blocks on a resource (which only happens under PIP or no
+ * protocol, or on a global resource) blocks its worker too: the jobs of
+ * the other tasks of its level wait behind it instead of running, and a
+ * deadlock stalls the whole level. The run controller reports those tasks
+ * (dispatch_print_queued).
+ *
+ * The jobs of a task always run on the same worker, so its trace ring and
+ * statistics keep a single writer.
+ **/
+
+// Run one job of d released at release; *end receives its completion time
+typedef void (*dispatch_job)(struct periodic_data *d, const struct timespec *release,
+                             struct timespec *end);
+
+struct dispatch_config
+{
+  struct timespec start;       // common first release (phase 0)
+  struct timespec end;         // no job is released from here on, if bounded
+  int bounded;
+  struct timespec measure;     // skipped releases before are not counted
+  overrun_policy overrun;      // catch-up queues late releases, skip drops them
+  int min_prio;                // SCHED_FIFO priority of task priority 0
+  dispatch_job job;
+  pthread_barrier_t *barrier;  // every thread waits on it before the first release
+  atomic_int *stopping;        // set when the run is stopped early
+};
+
+// Group the tasks of ts into one worker per priority level and CPU.
+// Returns the number of threads to create (the workers and the timer
+// thread), -1 if out of memory
+extern int dispatch_init(struct task_set *ts, const struct dispatch_config *cfg);
+
+// Create the timer thread (threads[0], one level above every task and
+// every ceiling) and
+// the workers with attr, which must already have an explicit SCHED_FIFO
+// policy. The threads return at the end of the run or when it is stopped
+extern int dispatch_start(pthread_attr_t *attr, pthread_t *threads);
+
+// Task whose job thread i is running, NULL if none (the timer thread or an
+// idle worker)
+extern struct periodic_data *dispatch_running(int i);
+
+// Print the tasks with jobs queued behind the one thread i is running
+extern void dispatch_print_queued(FILE *f, int i);
+
+// Print the workers and the tasks of each
+extern void dispatch_print(FILE *f);
+
+#endif
@@ -1,16 +1,115 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdatomic.h>
 #include "eat.h"
 #include "timespec_operations.h" /* for incr_timespec */
 
-void inline eat(const struct timespec *cpu_time)
+// Below this much remaining time eat() aims straight at the target, so
+// the last approach costs at most a few clock reads
+#define MIN_BLOCK_NS 2000
+
+static double iterations_per_ns; // 0 until eat_calibrate() has run
+static double clock_read_ns;     // cost of one CLOCK_THREAD_CPUTIME_ID read
+
+// Loop speed last observed by the calling thread
+static __thread double rate;
+
+// Accuracy and overhead counters (updated once per eat() call)
+static _Atomic uint64_t calls;
+static _Atomic uint64_t clock_reads;
+static _Atomic uint64_t overshoot_total_ns;
+static _Atomic uint64_t overshoot_max_ns;
+
+static inline int64_t cpu_now(void)
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t);
+    return (int64_t)t.tv_sec * 1000000000 + t.tv_nsec;
+}
+
+// Register-only loop; the empty asm keeps the compiler from removing it
+static void spin(uint64_t iterations)
 {
-    int err;
-    struct timespec current_time, time_to_go;
+    while (iterations--) {
+        __asm__ __volatile__("" ::: "memory");
+    }
+}
 
-    err = clock_gettime(CLOCK_THREAD_CPUTIME_ID, &current_time);
-    add_timespec(&time_to_go, &current_time, cpu_time);
+void eat_calibrate(void)
+{
+    const uint64_t n = 1000000;
+    int64_t start, elapsed, best = INT64_MAX;
+    int i;
 
-    while (smaller_timespec(&current_time, &time_to_go)) {
-        err = clock_gettime(CLOCK_THREAD_CPUTIME_ID, &current_time);
+    // Best of several runs, to discard interrupts and cold caches
+    for (i = 0; i < 5; i++) {
+        start = cpu_now();
+        spin(n);
+        elapsed = cpu_now() - start;
+        if (elapsed < best) {
+            best = elapsed;
+        }
     }
+    iterations_per_ns = (double)n / (best > 0 ? best : 1);
+
+    start = cpu_now();
+    for (i = 0; i < 1000; i++) {
+        cpu_now();
+    }
+    clock_read_ns = (cpu_now() - start) / 1000.0;
 }
 
+void eat(const struct timespec *cpu_time)
+{
+    int64_t now = cpu_now();
+    int64_t target = now + (int64_t)cpu_time->tv_sec * 1000000000 + cpu_time->tv_nsec;
+    uint64_t reads = 1, over, max;
+
+    if (rate == 0) {
+        rate = iterations_per_ns;
+    }
+
+    // Spin for half of what is left, then look at the clock again; the
+    // remaining time shrinks geometrically down to MIN_BLOCK_NS, and the
+    // loop speed is re-measured on every block because it varies with
+    // frequency scaling and with the load of the other cores
+    while (now < target) {
+        int64_t left = target - now;
+        int64_t block = (left < MIN_BLOCK_NS) ? left : left / 2;
+        uint64_t iterations = (uint64_t)(block * rate);
+        int64_t before = now;
+
+        spin(iterations);
+        now = cpu_now();
+        reads++;
+        if (iterations > 1000 && now > before) {
+            rate = (double)iterations / (now - before);
+        }
+    }
+
+    over = (uint64_t)(now - target);
+    atomic_fetch_add_explicit(&calls, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&clock_reads, reads, memory_order_relaxed);
+    atomic_fetch_add_explicit(&overshoot_total_ns, over, memory_order_relaxed);
+    max = atomic_load_explicit(&overshoot_max_ns, memory_order_relaxed);
+    while (over > max &&
+           !atomic_compare_exchange_weak_explicit(&overshoot_max_ns, &max, over,
+                                                  memory_order_relaxed,
+                                                  memory_order_relaxed)) {
+    }
+}
+
+void eat_report(void)
+{
+    uint64_t n = atomic_load(&calls);
+
+    printf("eat: %.3f ns/iteration, %.0f ns per CPU-clock read\n",
+           iterations_per_ns > 0 ? 1.0 / iterations_per_ns : 0.0, clock_read_ns);
+    if (n > 0) {
+        printf("eat: %llu calls, %.1f clock reads/call, overshoot avg %.1f us, max %.1f us\n",
+               (unsigned long long)n, (double)atomic_load(&clock_reads) / n,
+               atomic_load(&overshoot_total_ns) / 1000.0 / n,
+               atomic_load(&overshoot_max_ns) / 1000.0);
+    }
+}
@@ -5,8 +5,22 @@
 
 /**
  * @file eat.h
+ *
+ * CPU-time busy wait. eat() spins in user space for blocks whose length
+ * comes from a startup calibration and only reads CLOCK_THREAD_CPUTIME_ID
+ * between blocks, so a segment costs a handful of clock reads instead of
+ * one (often a system call) per loop iteration.
  **/
 
-extern void inline eat(const struct timespec *cpu_time);
+// Measure the cost of the spin loop and of a CPU-time clock read.
+// Call it once before the periodic threads start; until then eat()
+// polls the clock on every iteration
+extern void eat_calibrate(void);
+
+// Consume cpu_time of CPU time of the calling thread
+extern void eat(const struct timespec *cpu_time);
+
+// Print the calibration and the accuracy/overhead measured so far
+extern void eat_report(void);
 
 #endif
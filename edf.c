@@ -0,0 +1,63 @@
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <errno.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include "edf.h"
+
+// Layout of the kernel's struct sched_attr (linux/sched/types.h cannot be
+// included together with sched.h)
+struct edf_attr
+{
+  uint32_t size;
+  uint32_t sched_policy;
+  uint64_t sched_flags;
+  int32_t sched_nice;
+  uint32_t sched_priority;
+  uint64_t sched_runtime;
+  uint64_t sched_deadline;
+  uint64_t sched_period;
+};
+
+static inline int64_t ns(const struct timespec *t)
+{
+  return (int64_t)t->tv_sec * 1000000000 + t->tv_nsec;
+}
+
+int64_t edf_runtime(const struct periodic_data *d)
+{
+  struct timespec c = taskset_wcet(d);
+  int64_t q = (int64_t)(ns(&c) * EDF_RUNTIME_MARGIN);
+
+  return q < ns(&d->deadline) ? q : ns(&d->deadline);
+}
+
+int edf_set_deadline(const struct periodic_data *d)
+{
+  struct edf_attr attr = {0};
+
+  attr.size = sizeof(attr);
+  attr.sched_policy = SCHED_DEADLINE;
+  attr.sched_runtime = edf_runtime(d);
+  attr.sched_deadline = ns(&d->deadline);
+  attr.sched_period = ns(&d->period);
+  if (syscall(SYS_sched_setattr, 0, &attr, 0) != 0)
+    return errno;
+  return 0;
+}
+
+double edf_density(const struct task_set *ts)
+{
+  double density = 0.0;
+  int i;
+
+  for (i = 0; i < ts->ntasks; i++)
+  {
+    const struct periodic_data *d = &ts->tasks[i];
+    struct timespec c = taskset_wcet(d);
+
+    density += (double)ns(&c) / ns(&d->deadline);
+  }
+  return density;
+}
@@ -0,0 +1,35 @@
+#ifndef _EDF_H
+#define _EDF_H
+
+#include "taskset.h"
+
+/**
+ * @file edf.h
+ *
+ * SCHED_DEADLINE mode. Each periodic thread switches itself to the Linux
+ * EDF scheduler with a constant-bandwidth server of runtime Q (its
+ * execution time plus a margin), relative deadline D and period T, all
+ * taken from its periodic_data. The kernel admits the set only if the
+ * total bandwidth Q/T fits in what is reserved for real-time tasks, and
+ * throttles a job that exhausts its runtime until the next period.
+ * SCHED_DEADLINE threads run above every SCHED_FIFO thread and can only
+ * share resources through priority-inheritance mutexes, under which a
+ * blocked thread lends its deadline to the holder.
+ **/
+
+// Runtime given to a task, as a multiple of its execution time: covers
+// the trace, the lock layer and the error of the calibrated busy wait
+#define EDF_RUNTIME_MARGIN 1.05
+
+// Runtime of the server of d, in nanoseconds (never more than D)
+extern int64_t edf_runtime(const struct periodic_data *d);
+
+// Switch the calling thread to SCHED_DEADLINE with the parameters of d.
+// Returns 0 or an errno value (EBUSY if the bandwidth is not admitted)
+extern int edf_set_deadline(const struct periodic_data *d);
+
+// Density of the set, sum of C/min(D,T): with no blocking, EDF meets every
+// deadline if it is at most 1 (exactly when D = T)
+extern double edf_density(const struct task_set *ts);
+
+#endif
@@ -0,0 +1,250 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "load.h"
+
+#define LINE_BYTES 64
+#define LINE_WORDS (LINE_BYTES / sizeof(uint64_t))
+
+// One unit of the vector kernel: 4 independent multiply-adds of 8 lanes
+typedef float v8f __attribute__((vector_size(32)));
+#define SIMD_VECTORS (LOAD_SIMD_BYTES / sizeof(v8f))
+#define SIMD_FLOPS_PER_UNIT 64
+
+static const char *kernel_name[LOAD_KERNELS] = {"spin", "stream", "chase", "simd"};
+
+static inline int64_t cpu_now(void)
+{
+  struct timespec t;
+
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t);
+  return (int64_t)t.tv_sec * 1000000000 + t.tv_nsec;
+}
+
+// Read and write units cache lines, wrapping around the working set
+static void stream(struct load_arena *a, uint64_t units)
+{
+  size_t pos = a->stream_pos;
+
+  while (units--)
+  {
+    uint64_t *line = &a->stream[pos * LINE_WORDS];
+    size_t i;
+
+    for (i = 0; i < LINE_WORDS; i++)
+      line[i]++;
+    if (++pos == a->stream_lines)
+      pos = 0;
+  }
+  a->stream_pos = pos;
+}
+
+// Follow units links; every load depends on the previous one
+static void chase(struct load_arena *a, uint64_t units)
+{
+  size_t pos = a->chase_pos;
+
+  while (units--)
+    pos = a->chase[pos * LINE_WORDS];
+  a->chase_pos = pos;
+}
+
+// units blocks of vector multiply-adds over the page; the accumulators
+// converge to 1, so the values never overflow nor become denormal
+static void simd(struct load_arena *a, uint64_t units)
+{
+  const v8f *v = (const v8f *)a->simd;
+  v8f acc0 = v[0], acc1 = v[1], acc2 = v[2], acc3 = v[3], half = v[0];
+  size_t k = 0;
+
+  while (units--)
+  {
+    acc0 = acc0 * v[k] + half;
+    acc1 = acc1 * v[k + 1] + half;
+    acc2 = acc2 * v[k + 2] + half;
+    acc3 = acc3 * v[k + 3] + half;
+    k = (k + 4) % SIMD_VECTORS;
+  }
+  acc0 += acc1 + acc2 + acc3;
+  a->sink += acc0[0] + acc0[7];
+}
+
+static void run_kernel(struct load_arena *a, int kind, uint64_t units)
+{
+  switch (kind)
+  {
+  case LOAD_STREAM:
+    stream(a, units);
+    break;
+  case LOAD_CHASE:
+    chase(a, units);
+    break;
+  case LOAD_SIMD:
+    simd(a, units);
+    break;
+  }
+}
+
+// Link the lines of the chase area into a single random cycle (Sattolo),
+// so that the hardware prefetchers cannot guess the next line
+static void link_cycle(struct load_arena *a)
+{
+  uint64_t state = 0x2545f4914f6cdd1dULL;
+  size_t *order = malloc(a->chase_lines * sizeof(size_t));
+  size_t i, j, tmp;
+
+  if (order == NULL)
+  {
+    // Sequential cycle: still a dependent chain, but prefetchable
+    for (i = 0; i < a->chase_lines; i++)
+      a->chase[i * LINE_WORDS] = (i + 1) % a->chase_lines;
+    return;
+  }
+  for (i = 0; i < a->chase_lines; i++)
+    order[i] = i;
+  for (i = a->chase_lines - 1; i > 0; i--)
+  {
+    // xorshift64: only the order matters, not its quality
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    j = state % i;
+    tmp = order[i];
+    order[i] = order[j];
+    order[j] = tmp;
+  }
+  for (i = 0; i < a->chase_lines; i++)
+    a->chase[order[i] * LINE_WORDS] = order[(i + 1) % a->chase_lines];
+  free(order);
+}
+
+// Time one kernel on its arena: a warm-up pass, then the best of three
+static double calibrate(struct load_arena *a, int kind, size_t lines)
+{
+  uint64_t units = lines > 65536 ? lines : 65536;
+  int64_t start, elapsed, best = INT64_MAX;
+  int i;
+
+  run_kernel(a, kind, units);
+  for (i = 0; i < 3; i++)
+  {
+    start = cpu_now();
+    run_kernel(a, kind, units);
+    elapsed = cpu_now() - start;
+    if (elapsed < best)
+      best = elapsed;
+  }
+  return (double)(best > 0 ? best : 1) / units;
+}
+
+int load_init(struct task_set *ts)
+{
+  int i, k;
+
+  for (i = 0; i < ts->ntasks; i++)
+  {
+    struct periodic_data *d = &ts->tasks[i];
+    int used[LOAD_KERNELS] = {0};
+    struct load_arena *a;
+    size_t ws = d->ws > 0 ? d->ws : LOAD_DEFAULT_WS;
+
+    for (k = 0; k < d->nsegments; k++)
+    {
+      if (d->segments[k].kind == SEGMENT_COMPUTE)
+        used[d->segments[k].load] = 1;
+    }
+    if (!used[LOAD_STREAM] && !used[LOAD_CHASE] && !used[LOAD_SIMD])
+      continue;
+
+    if ((a = d->arena = calloc(1, sizeof(struct load_arena))) == NULL)
+      return -1;
+    ws = (ws + LINE_BYTES - 1) / LINE_BYTES * LINE_BYTES;
+    if (used[LOAD_STREAM])
+    {
+      if ((a->stream = aligned_alloc(LINE_BYTES, ws)) == NULL)
+        return -1;
+      memset(a->stream, 0, ws);
+      a->stream_lines = ws / LINE_BYTES;
+      a->ns_per_unit[LOAD_STREAM] = calibrate(a, LOAD_STREAM, a->stream_lines);
+    }
+    if (used[LOAD_CHASE])
+    {
+      if ((a->chase = aligned_alloc(LINE_BYTES, ws)) == NULL)
+        return -1;
+      memset(a->chase, 0, ws);
+      a->chase_lines = ws / LINE_BYTES;
+      link_cycle(a);
+      a->ns_per_unit[LOAD_CHASE] = calibrate(a, LOAD_CHASE, a->chase_lines);
+    }
+    if (used[LOAD_SIMD])
+    {
+      if ((a->simd = aligned_alloc(LINE_BYTES, LOAD_SIMD_BYTES)) == NULL)
+        return -1;
+      for (k = 0; k < (int)(LOAD_SIMD_BYTES / sizeof(float)); k++)
+        a->simd[k] = 0.5f;
+      a->ns_per_unit[LOAD_SIMD] = calibrate(a, LOAD_SIMD, 0);
+    }
+  }
+  return 0;
+}
+
+void load_run(struct periodic_data *d, const struct segment *s, const struct timespec *time)
+{
+  struct load_arena *a = d->arena;
+  struct load_counters *c = &a->count[s->load];
+  int64_t nominal = (int64_t)time->tv_sec * 1000000000 + time->tv_nsec;
+  uint64_t units = (uint64_t)(nominal / a->ns_per_unit[s->load] + 0.5);
+  int64_t start = cpu_now();
+
+  run_kernel(a, s->load, units);
+  c->cpu_ns += cpu_now() - start;
+  c->segments++;
+  c->units += units;
+  c->nominal_ns += nominal;
+}
+
+// Rate of a kernel over units done in ns: GB/s, ns per hop or GFLOP/s
+static double rate(int kind, double units, double ns)
+{
+  if (units <= 0 || ns <= 0)
+    return 0.0;
+  switch (kind)
+  {
+  case LOAD_STREAM:
+    return units * 2 * LINE_BYTES / ns; // each line is read and written back
+  case LOAD_CHASE:
+    return ns / units;
+  default:
+    return units * SIMD_FLOPS_PER_UNIT / ns;
+  }
+}
+
+void load_report(FILE *f, const struct task_set *ts)
+{
+  int i, k, header = 0;
+
+  for (i = 0; i < ts->ntasks; i++)
+  {
+    const struct load_arena *a = ts->tasks[i].arena;
+
+    if (a == NULL)
+      continue;
+    if (!header)
+      fprintf(f, "Load kernels (rate: stream GB/s, chase ns/hop, simd GFLOP/s):\n"
+                 "  Task Kernel  Segments        Units  Nominal s    CPU s  Inflation"
+                 "     Rate    Alone\n");
+    header = 1;
+    for (k = LOAD_STREAM; k < LOAD_KERNELS; k++)
+    {
+      const struct load_counters *c = &a->count[k];
+
+      if (a->ns_per_unit[k] == 0)
+        continue;
+      fprintf(f, "  %4d %-6s %9llu %12llu %10.3f %8.3f %10.2f %8.2f %8.2f\n", ts->tasks[i].id,
+              kernel_name[k], (unsigned long long)c->segments, (unsigned long long)c->units,
+              c->nominal_ns / 1.0e9, c->cpu_ns / 1.0e9,
+              c->nominal_ns > 0 ? (double)c->cpu_ns / c->nominal_ns : 0.0,
+              rate(k, c->units, c->cpu_ns), rate(k, 1.0, a->ns_per_unit[k]));
+    }
+  }
+}
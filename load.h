@@ -0,0 +1,68 @@
+#ifndef _LOAD_H
+#define _LOAD_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+#include "taskset.h"
+
+/**
+ * @file load.h
+ *
+ * Load kernels for the compute segments that are not a plain spin. Each
+ * task that uses one gets its own arena: a working set of ws bytes for
+ * the streaming kernel (M:), another one linked as a random cycle of cache
+ * lines for the pointer chase (P:), and one page for the vector kernel
+ * (V:). At startup every kernel is timed on its arena with nothing else
+ * running, and a segment then does the amount of work that took its time
+ * alone. Unlike eat(), which always stops after the given CPU time, the
+ * kernels take longer when other tasks evict their data or compete for
+ * memory bandwidth, and the inflation shows in the response times.
+ **/
+
+// Working set of a task without ws=, in bytes
+#define LOAD_DEFAULT_WS (8 << 20)
+
+// Bytes used by the vector kernel, small enough to stay in the L1 cache
+#define LOAD_SIMD_BYTES 4096
+
+// Work done by the segments of one kernel of a task (written by the task)
+struct load_counters
+{
+  uint64_t segments;
+  uint64_t units;     // cache lines streamed, hops, or vector blocks
+  int64_t nominal_ns; // time the segments take alone
+  int64_t cpu_ns;     // CPU time they took
+};
+
+struct load_arena
+{
+  uint64_t *stream;   // ws bytes, cache-line aligned
+  size_t stream_lines;
+  size_t stream_pos;  // next line of the streaming kernel
+  uint64_t *chase;    // ws bytes, each line holds the index of the next one
+  size_t chase_lines;
+  size_t chase_pos;   // current line of the pointer chase
+  float *simd;        // LOAD_SIMD_BYTES
+  float sink;         // keeps the vector results alive
+  double ns_per_unit[LOAD_KERNELS]; // measured alone, 0 if not used
+  struct load_counters count[LOAD_KERNELS];
+};
+
+// Allocate and initialize the arenas of the tasks that use a kernel and
+// time the kernels. Call from a thread that nothing preempts, after
+// rt_lock_memory() and before the periodic threads start
+extern int load_init(struct task_set *ts);
+
+// Execute compute segment s of d for time (its draw from the distribution,
+// or the time of a fault) with its load kernel
+extern void load_run(struct periodic_data *d, const struct segment *s,
+                     const struct timespec *time);
+
+// Print, per task and kernel, the work done, the achieved bandwidth, hop
+// latency or arithmetic rate next to the one measured alone, and the
+// inflation of the execution time
+extern void load_report(FILE *f, const struct task_set *ts);
+
+#endif
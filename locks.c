@@ -0,0 +1,301 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include "locks.h"
+#include "srp.h"
+
+static struct task_set *set;
+static deadlock_policy on_deadlock;
+static int use_srp;
+
+int locks_init(struct task_set *ts, deadlock_policy policy, int srp)
+{
+  int i;
+
+  set = ts;
+  on_deadlock = policy;
+  use_srp = srp;
+  for (i = 0; i < ts->nresources; i++)
+  {
+    struct resource *r = &ts->resources[i];
+
+    atomic_init(&r->owner, -1);
+    // Already in the shared-memory segment if the metrics are published
+    if (r->profile != NULL)
+    {
+      continue;
+    }
+    r->profile = aligned_alloc(64, ts->ntasks * sizeof(struct lock_profile));
+    if (r->profile == NULL)
+    {
+      return -1;
+    }
+    memset(r->profile, 0, ts->ntasks * sizeof(struct lock_profile));
+  }
+  for (i = 0; i < ts->ntasks; i++)
+  {
+    struct periodic_data *d = &ts->tasks[i];
+
+    d->index = i;
+    atomic_init(&d->waiting_for, -1);
+    d->nheld = 0;
+    d->held = calloc(ts->nresources ? ts->nresources : 1, sizeof(int));
+    d->cycle = calloc(ts->nresources ? 2 * ts->nresources : 1, sizeof(int));
+    if (d->held == NULL || d->cycle == NULL)
+    {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+int locks_parse_policy(const char *name, deadlock_policy *policy)
+{
+  if (strcmp(name, "report") == 0)
+    *policy = DEADLOCK_REPORT;
+  else if (strcmp(name, "abort") == 0)
+    *policy = DEADLOCK_ABORT;
+  else if (strcmp(name, "recover") == 0)
+    *policy = DEADLOCK_RECOVER;
+  else
+    return -1;
+  return 0;
+}
+
+// Follow the wait-for graph from resource want. Returns the length of the
+// cycle that leads back to d (owners in tasks[], the resources they are
+// waiting for in res[]), or 0 if the chain ends in a running task. The
+// owners on a chain back to d are distinct, and so are their resources,
+// so it is at most nresources long; a longer one loops elsewhere
+static int find_cycle(const struct periodic_data *d, int want, int *tasks, int *res)
+{
+  int r = want, n = 0, t;
+
+  while (n < set->nresources)
+  {
+    t = atomic_load(&set->resources[r].owner);
+    if (t < 0)
+      return 0;
+    res[n] = r;
+    tasks[n] = t;
+    n++;
+    if (t == d->index)
+      return n;
+    r = atomic_load(&set->tasks[t].waiting_for);
+    if (r < 0)
+      return 0;
+  }
+  return 0;
+}
+
+static void report_cycle(const struct periodic_data *d, int n, const int *tasks,
+                         const int *res, long detect_ns)
+{
+  int i, waiter = d->index;
+
+  fprintf(stderr, "Deadlock detected in %ld ns:", detect_ns);
+  for (i = 0; i < n; i++)
+  {
+    fprintf(stderr, " task %d waits for R%d held by task %d%s",
+            set->tasks[waiter].id, set->resources[res[i]].id,
+            set->tasks[tasks[i]].id, i + 1 < n ? "," : "\n");
+    waiter = tasks[i];
+  }
+}
+
+// Take, try and release r: its pthread mutex, or its SRP lock
+static inline void mutex_lock(struct periodic_data *d, struct resource *r)
+{
+  if (use_srp)
+    srp_lock(d, r);
+  else
+    pthread_mutex_lock(&r->mutex);
+}
+
+static inline int mutex_trylock(struct periodic_data *d, struct resource *r)
+{
+  return use_srp ? srp_trylock(d, r) : pthread_mutex_trylock(&r->mutex);
+}
+
+static inline void mutex_unlock(struct periodic_data *d, struct resource *r)
+{
+  if (use_srp)
+    srp_unlock(d, r);
+  else
+    pthread_mutex_unlock(&r->mutex);
+}
+
+static inline int64_t ns(const struct timespec *t)
+{
+  return (int64_t)t->tv_sec * 1000000000 + t->tv_nsec;
+}
+
+// Add v to a total and raise a maximum; only called by the owner of both
+static inline void profile_add(_Atomic uint64_t *total, _Atomic uint64_t *max, uint64_t v)
+{
+  stats_count(total, v);
+  if (v > atomic_load_explicit(max, memory_order_relaxed))
+    atomic_store_explicit(max, v, memory_order_relaxed);
+}
+
+int resource_lock(struct periodic_data *d, struct resource *r)
+{
+  int want = (int)(r - set->resources);
+  int *tasks = d->cycle, *res = d->cycle + set->nresources;
+  struct lock_profile *p = &r->profile[d->index];
+  struct timespec t0, t1;
+  int n, owner;
+
+  // Free: no wait edge and nothing to look for
+  if (mutex_trylock(d, r) == 0)
+  {
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    goto acquired;
+  }
+
+  // Publish the wait edge first, then look for a cycle through it. With
+  // sequentially consistent accesses, of two threads closing a cycle at
+  // the same time at least one sees the other's edge
+  atomic_store(&d->waiting_for, want);
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  n = find_cycle(d, want, tasks, res);
+  if (n > 0)
+  {
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    trace_emit(d->trace, TRACE_DEADLOCK, d->id, r->id, 0);
+    report_cycle(d, n, tasks, res,
+                 (t1.tv_sec - t0.tv_sec) * 1000000000L + (t1.tv_nsec - t0.tv_nsec));
+    if (on_deadlock == DEADLOCK_ABORT)
+    {
+      trace_flush();
+      exit(3);
+    }
+    if (on_deadlock == DEADLOCK_RECOVER)
+    {
+      atomic_store(&d->waiting_for, -1);
+      return EDEADLK;
+    }
+  }
+
+  // A failed trylock is a contended acquisition; the owner is sampled
+  // then to tell priority inversion from waiting behind a higher-priority
+  // task (it reads -1 if the holder has only just locked or unlocked)
+  owner = atomic_load(&r->owner);
+  mutex_lock(d, r);
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  stats_count(&p->contended, 1);
+  profile_add(&p->wait_total, &p->wait_max, ns(&t1) - ns(&t0));
+  if (owner >= 0 && set->tasks[owner].prio < d->prio)
+  {
+    stats_count(&p->inversions, 1);
+    profile_add(&p->inversion_total, &p->inversion_max, ns(&t1) - ns(&t0));
+  }
+
+acquired:
+  stats_count(&p->acquisitions, 1);
+  p->acquired_at = ns(&t1);
+  atomic_store(&r->owner, d->index);
+  atomic_store(&d->waiting_for, -1);
+  d->held[d->nheld++] = want;
+  return 0;
+}
+
+void resource_unlock(struct periodic_data *d, struct resource *r)
+{
+  int idx = (int)(r - set->resources);
+  struct lock_profile *p = &r->profile[d->index];
+  struct timespec now;
+  int i;
+
+  for (i = d->nheld - 1; i >= 0; i--)
+  {
+    if (d->held[i] == idx)
+    {
+      memmove(&d->held[i], &d->held[i + 1], (d->nheld - i - 1) * sizeof(int));
+      d->nheld--;
+      break;
+    }
+  }
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  stats_count(&p->releases, 1);
+  profile_add(&p->hold_total, &p->hold_max, ns(&now) - p->acquired_at);
+  atomic_store(&r->owner, -1);
+  mutex_unlock(d, r);
+}
+
+void resource_unlock_all(struct periodic_data *d)
+{
+  while (d->nheld > 0)
+  {
+    struct resource *r = &set->resources[d->held[d->nheld - 1]];
+
+    resource_unlock(d, r);
+    trace_emit(d->trace, TRACE_LOCK_RELEASED, d->id, r->id, 0);
+  }
+}
+
+static uint64_t load(_Atomic uint64_t *c)
+{
+  return atomic_load_explicit(c, memory_order_relaxed);
+}
+
+static void dump_row(FILE *f, int task, const char *metric, int res, uint64_t n,
+                     uint64_t total, uint64_t max)
+{
+  fprintf(f, "%d,%s_R%d,%llu,0,%llu,0,0,0,%llu\n", task, metric, res, (unsigned long long)n,
+          (unsigned long long)(n ? total / n : 0), (unsigned long long)max);
+}
+
+void locks_dump_profile(FILE *f, const struct task_set *ts)
+{
+  int i, k;
+
+  for (k = 0; k < ts->nresources; k++)
+  {
+    const struct resource *r = &ts->resources[k];
+
+    for (i = 0; i < ts->ntasks; i++)
+    {
+      struct lock_profile *p = &r->profile[i];
+      uint64_t n = load(&p->acquisitions);
+
+      if (n == 0)
+        continue;
+      dump_row(f, ts->tasks[i].id, "lock_wait", r->id, load(&p->contended),
+               load(&p->wait_total), load(&p->wait_max));
+      dump_row(f, ts->tasks[i].id, "inversion", r->id, load(&p->inversions),
+               load(&p->inversion_total), load(&p->inversion_max));
+      dump_row(f, ts->tasks[i].id, "lock_hold", r->id, load(&p->releases),
+               load(&p->hold_total), load(&p->hold_max));
+    }
+  }
+}
+
+void locks_print_profile(FILE *f, const struct task_set *ts)
+{
+  int i, k;
+
+  fprintf(f, "Resource contention (ms):\n");
+  fprintf(f, "  %4s %4s %9s %9s %9s %9s %9s %9s %9s %9s\n", "Res", "Task", "Locks",
+          "Contended", "Wait", "Max wait", "Inversion", "Max inv", "Hold", "Max hold");
+  for (k = 0; k < ts->nresources; k++)
+  {
+    const struct resource *r = &ts->resources[k];
+
+    for (i = 0; i < ts->ntasks; i++)
+    {
+      struct lock_profile *p = &r->profile[i];
+
+      if (load(&p->acquisitions) == 0)
+        continue;
+      fprintf(f, "  R%-3d %4d %9llu %9llu %9.3f %9.3f %9.3f %9.3f %9.3f %9.3f\n", r->id,
+              ts->tasks[i].id, (unsigned long long)load(&p->acquisitions),
+              (unsigned long long)load(&p->contended), load(&p->wait_total) / 1.0e6,
+              load(&p->wait_max) / 1.0e6, load(&p->inversion_total) / 1.0e6,
+              load(&p->inversion_max) / 1.0e6, load(&p->hold_total) / 1.0e6,
+              load(&p->hold_max) / 1.0e6);
+    }
+  }
+  fflush(f);
+}
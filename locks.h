@@ -0,0 +1,77 @@
+#ifndef _LOCKS_H
+#define _LOCKS_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include "taskset.h"
+
+/**
+ * @file locks.h
+ *
+ * Instrumented lock layer used by periodic() for every resource. Each
+ * resource records its owner and each task the resource it is waiting
+ * for; together they form the wait-for graph. Before blocking, a thread
+ * follows the owner/waiting_for chain from the resource it wants (at most
+ * one step per task), so a cycle is detected by the thread that closes
+ * it, before it goes to sleep.
+ *
+ * The layer also profiles the contention on every resource: how often
+ * each task takes it and finds it held, how long it waits (and how much
+ * of that behind a lower-priority owner, i.e. priority inversion) and how
+ * long it holds it.
+ **/
+
+// Contention counters of one task on one resource, in nanoseconds. Each
+// profile has a single writer (the task) and its own cache line, so the
+// tasks sharing a resource never write to the same line
+struct lock_profile
+{
+  _Alignas(64) _Atomic uint64_t acquisitions;
+  _Atomic uint64_t contended;       // acquisitions that found it held
+  _Atomic uint64_t wait_total;      // time spent waiting in contended ones
+  _Atomic uint64_t wait_max;
+  _Atomic uint64_t inversions;      // contended ones behind a lower-priority owner
+  _Atomic uint64_t inversion_total; // time spent waiting in those
+  _Atomic uint64_t inversion_max;
+  _Atomic uint64_t releases;
+  _Atomic uint64_t hold_total;      // time from acquisition to release
+  _Atomic uint64_t hold_max;
+  int64_t acquired_at;              // CLOCK_MONOTONIC time of the current hold
+};
+
+typedef enum
+{
+  DEADLOCK_REPORT,  // print the cycle and block anyway (the demonstration)
+  DEADLOCK_ABORT,   // print the cycle and exit with status 3
+  DEADLOCK_RECOVER  // print the cycle; the thread that closes it gives up
+                    // its job and releases everything it holds
+} deadlock_policy;
+
+// Prepare the per-task lock state of ts. With srp the resources are
+// taken with the locks of srp.h (initialized by srp_init) instead of
+// their mutexes
+extern int locks_init(struct task_set *ts, deadlock_policy policy, int srp);
+
+// Parse "report", "abort" or "recover"; -1 if unknown
+extern int locks_parse_policy(const char *name, deadlock_policy *policy);
+
+// Lock r on behalf of d. Returns 0, or EDEADLK if locking would deadlock
+// and the policy is DEADLOCK_RECOVER
+extern int resource_lock(struct periodic_data *d, struct resource *r);
+
+extern void resource_unlock(struct periodic_data *d, struct resource *r);
+
+// Release everything d holds, in reverse lock order
+extern void resource_unlock_all(struct periodic_data *d);
+
+// Write the contention profile as rows of the stats_dump CSV, per task
+// and resource: lock_wait_Rk (count = contended acquisitions, mean and
+// max wait), inversion_Rk (count = waits behind a lower-priority owner)
+// and lock_hold_Rk (count = releases, mean and max hold)
+extern void locks_dump_profile(FILE *f, const struct task_set *ts);
+
+// Print the contention profile of every resource
+extern void locks_print_profile(FILE *f, const struct task_set *ts);
+
+#endif
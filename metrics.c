@@ -0,0 +1,90 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "metrics.h"
+#include "locks.h"
+
+static struct metrics_header *header;
+static char segment_name[256];
+
+// Round n up to a whole number of cache lines
+static size_t line_up(size_t n)
+{
+  return (n + 63) & ~(size_t)63;
+}
+
+int metrics_open(const char *name, struct task_set *ts)
+{
+  size_t task_offset = line_up(sizeof(struct metrics_header));
+  size_t profile_offset = task_offset + line_up(ts->ntasks * sizeof(struct task_metrics));
+  size_t size = profile_offset +
+                (size_t)ts->nresources * ts->ntasks * sizeof(struct lock_profile);
+  struct task_metrics *tasks;
+  struct lock_profile *profiles;
+  int fd, i;
+
+  // The name must start with a slash and contain no other
+  if (name[0] == '/')
+    snprintf(segment_name, sizeof(segment_name), "%s", name);
+  else
+    snprintf(segment_name, sizeof(segment_name), "/%s", name);
+  shm_unlink(segment_name);
+  fd = shm_open(segment_name, O_RDWR | O_CREAT | O_EXCL, 0644);
+  if (fd < 0)
+  {
+    perror(segment_name);
+    return -1;
+  }
+  if (ftruncate(fd, size) != 0)
+  {
+    perror(segment_name);
+    close(fd);
+    return -1;
+  }
+  header = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (header == MAP_FAILED)
+  {
+    perror(segment_name);
+    header = NULL;
+    return -1;
+  }
+
+  // The segment is zeroed by ftruncate; the magic goes last, so that a
+  // monitor never sees a header that is not complete
+  header->version = METRICS_VERSION;
+  header->size = size;
+  header->ntasks = ts->ntasks;
+  header->nresources = ts->nresources;
+  header->task_offset = task_offset;
+  header->profile_offset = profile_offset;
+  header->pid = getpid();
+  atomic_store(&header->running, 1);
+
+  tasks = (struct task_metrics *)((char *)header + task_offset);
+  profiles = (struct lock_profile *)((char *)header + profile_offset);
+  for (i = 0; i < ts->ntasks; i++)
+  {
+    tasks[i].id = ts->tasks[i].id;
+    tasks[i].prio = ts->tasks[i].prio;
+    ts->tasks[i].metrics = &tasks[i];
+  }
+  for (i = 0; i < ts->nresources; i++)
+  {
+    ts->resources[i].profile = &profiles[i * ts->ntasks];
+  }
+  atomic_thread_fence(memory_order_release);
+  memcpy(header->magic, METRICS_MAGIC, sizeof(header->magic));
+  return 0;
+}
+
+void metrics_close(void)
+{
+  if (header == NULL)
+    return;
+  atomic_store(&header->running, 0);
+  shm_unlink(segment_name);
+}
@@ -0,0 +1,108 @@
+#ifndef _METRICS_H
+#define _METRICS_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include "taskset.h"
+
+/**
+ * @file metrics.h
+ *
+ * Live metrics in a POSIX shared-memory segment, for monitors outside the
+ * process (see psrmon). The segment holds a header, one task_metrics per
+ * task and the lock contention profiles of locks.h, which the lock layer
+ * then updates in place. Every record has a single writer, the thread
+ * running the task's jobs: a task record is published with a sequence
+ * lock (odd while it is being written), so a reader gets a consistent
+ * snapshot by retrying, and the writer never waits for the readers.
+ **/
+
+#define METRICS_MAGIC "PSRMETRC"
+#define METRICS_VERSION 1
+
+// Layout of the segment: the header, ntasks task_metrics at task_offset
+// and nresources x ntasks lock_profile at profile_offset (the profile of
+// task i on R(k+1) is number k * ntasks + i)
+struct metrics_header
+{
+  char magic[8];          // METRICS_MAGIC
+  uint32_t version;       // METRICS_VERSION
+  uint32_t size;          // bytes of the segment
+  int32_t ntasks;
+  int32_t nresources;
+  uint32_t task_offset;   // bytes from the start of the segment
+  uint32_t profile_offset;
+  int32_t pid;            // process that writes the metrics
+  _Atomic int32_t running; // 0 once the run has ended
+};
+
+// Counters of one task; response times in nanoseconds
+struct task_metrics
+{
+  _Alignas(64) _Atomic uint32_t seq; // odd while the writer updates the record
+  int32_t id;
+  int32_t prio;
+  _Atomic uint64_t jobs;
+  _Atomic uint64_t misses;
+  _Atomic int64_t last_release;  // CLOCK_MONOTONIC time, in ns
+  _Atomic int64_t last_response;
+  _Atomic int64_t worst_response;
+};
+
+// Create the segment /name (replacing an old one) for ts, point every
+// task and resource of ts to its records and fill in the header. Call
+// before locks_init, which then keeps the profiles in the segment
+extern int metrics_open(const char *name, struct task_set *ts);
+
+// Mark the run as ended and remove the name of the segment; monitors
+// that have it mapped keep the last values
+extern void metrics_close(void);
+
+// Publish a completed job of the task of m (called by its thread only)
+static inline void metrics_job(struct task_metrics *m, int64_t release, int64_t response,
+                               int missed)
+{
+  uint32_t seq = atomic_load_explicit(&m->seq, memory_order_relaxed);
+
+  atomic_store_explicit(&m->seq, seq + 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  atomic_store_explicit(&m->jobs, atomic_load_explicit(&m->jobs, memory_order_relaxed) + 1,
+                        memory_order_relaxed);
+  if (missed)
+    atomic_store_explicit(&m->misses,
+                          atomic_load_explicit(&m->misses, memory_order_relaxed) + 1,
+                          memory_order_relaxed);
+  atomic_store_explicit(&m->last_release, release, memory_order_relaxed);
+  atomic_store_explicit(&m->last_response, response, memory_order_relaxed);
+  if (response > atomic_load_explicit(&m->worst_response, memory_order_relaxed))
+    atomic_store_explicit(&m->worst_response, response, memory_order_relaxed);
+  atomic_store_explicit(&m->seq, seq + 2, memory_order_release);
+}
+
+// Consistent copy of *m (the counters only), retrying while it is being
+// written. Returns -1 if it never settles (the writer died in the middle)
+static inline int metrics_read(const struct task_metrics *m, uint64_t *jobs,
+                               uint64_t *misses, int64_t *last_release,
+                               int64_t *last_response, int64_t *worst_response)
+{
+  uint32_t seq;
+  int tries;
+
+  for (tries = 0; tries < 100000; tries++)
+  {
+    seq = atomic_load_explicit(&m->seq, memory_order_acquire);
+    if (seq & 1)
+      continue;
+    *jobs = atomic_load_explicit(&m->jobs, memory_order_relaxed);
+    *misses = atomic_load_explicit(&m->misses, memory_order_relaxed);
+    *last_release = atomic_load_explicit(&m->last_release, memory_order_relaxed);
+    *last_response = atomic_load_explicit(&m->last_response, memory_order_relaxed);
+    *worst_response = atomic_load_explicit(&m->worst_response, memory_order_relaxed);
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&m->seq, memory_order_relaxed) == seq)
+      return 0;
+  }
+  return -1;
+}
+
+#endif
@@ -0,0 +1,437 @@
+#define _GNU_SOURCE // sched_setaffinity
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "timespec_operations.h"
+#include "srp.h"
+
+/**
+ * Microbenchmarks of the primitives periodic_sr stands on: clock reads,
+ * timespec arithmetic against plain int64 nanoseconds, mutex lock/unlock
+ * pairs under every protocol and the SRP locks of srp.h (uncontended,
+ * and contended by a higher-priority thread), and the wake-up latency of
+ * clock_nanosleep.
+ * Every benchmark runs a number of repetitions after an untimed warm-up
+ * one; the table (or CSV with -c) gives min, median, mean, standard
+ * deviation and max of the cost per operation across repetitions, so two
+ * runs can be compared and a regression told from noise. Run as root: the
+ * process is locked in memory, pinned to one CPU and run under SCHED_FIFO,
+ * which PTHREAD_PRIO_PROTECT needs.
+ **/
+
+// SCHED_FIFO priority of the benchmark thread (the contending thread runs
+// one level above)
+#define BENCH_PRIO 50
+
+struct bench_stats
+{
+  double min, median, mean, stddev, max;
+};
+
+static int reps = 15;      // timed repetitions of every benchmark
+static long base_ops = 1000000; // operations per repetition of the cheap benchmarks
+static int csv;
+static int realtime;       // running under SCHED_FIFO
+
+static inline int64_t now_ns(void)
+{
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (int64_t)t.tv_sec * 1000000000 + t.tv_nsec;
+}
+
+static int by_value(const void *a, const void *b)
+{
+  double x = *(const double *)a, y = *(const double *)b;
+
+  return (x > y) - (x < y);
+}
+
+static void summarize(double *v, int n, struct bench_stats *s)
+{
+  double sum = 0.0, sq = 0.0;
+  int i;
+
+  qsort(v, n, sizeof(double), by_value);
+  for (i = 0; i < n; i++)
+    sum += v[i];
+  s->mean = sum / n;
+  for (i = 0; i < n; i++)
+    sq += (v[i] - s->mean) * (v[i] - s->mean);
+  s->stddev = n > 1 ? sqrt(sq / (n - 1)) : 0.0;
+  s->min = v[0];
+  s->max = v[n - 1];
+  s->median = n % 2 ? v[n / 2] : (v[n / 2 - 1] + v[n / 2]) / 2.0;
+}
+
+static void print_header(void)
+{
+  if (csv)
+    printf("benchmark,reps,ops,min_ns,median_ns,mean_ns,stddev_ns,max_ns\n");
+  else
+    printf("%-36s %5s %9s %9s %9s %9s %9s %9s\n", "Benchmark (ns/op)", "Reps", "Ops/rep", "Min",
+           "Median", "Mean", "Stddev", "Max");
+}
+
+static void print_row(const char *name, int n, long ops, const struct bench_stats *s)
+{
+  if (csv)
+    printf("%s,%d,%ld,%.2f,%.2f,%.2f,%.2f,%.2f\n", name, n, ops, s->min, s->median, s->mean,
+           s->stddev, s->max);
+  else
+    printf("%-36s %5d %9ld %9.1f %9.1f %9.1f %9.1f %9.1f\n", name, n, ops, s->min, s->median,
+           s->mean, s->stddev, s->max);
+  fflush(stdout);
+}
+
+// Run body(ops, arg) once untimed and reps times timed; body returns the
+// elapsed time of its ops operations in nanoseconds
+static void run(const char *name, long ops, int64_t (*body)(long, void *), void *arg)
+{
+  double per_op[reps];
+  struct bench_stats s;
+  int i;
+
+  body(ops, arg);
+  for (i = 0; i < reps; i++)
+    per_op[i] = (double)body(ops, arg) / ops;
+  summarize(per_op, reps, &s);
+  print_row(name, reps, ops, &s);
+}
+
+// --- Clocks ---
+
+static int64_t bench_clock(long ops, void *arg)
+{
+  clockid_t id = *(clockid_t *)arg;
+  struct timespec t;
+  int64_t start = now_ns();
+  long i;
+
+  for (i = 0; i < ops; i++)
+  {
+    clock_gettime(id, &t);
+    __asm__ __volatile__("" : : "r"(&t) : "memory");
+  }
+  return now_ns() - start;
+}
+
+// --- Time arithmetic: one release step of periodic() (next += T, D =
+// next + d, compare with now, response = now - next) in both
+// representations. The asm barriers keep the values in memory so that
+// the loop is not folded away ---
+
+static int64_t bench_timespec(long ops, void *arg)
+{
+  struct timespec next = {1000, 0}, now = {1000, 500000000}, period = {0, 1400000};
+  struct timespec rel_deadline = {0, 1000000}, deadline, response;
+  int late = 0;
+  int64_t start = now_ns();
+  long i;
+
+  (void)arg;
+  for (i = 0; i < ops; i++)
+  {
+    incr_timespec(&next, &period);
+    add_timespec(&deadline, &next, &rel_deadline);
+    late += smaller_timespec(&deadline, &now);
+    response = now;
+    decr_timespec(&response, &next);
+    __asm__ __volatile__("" : : "r"(&next), "r"(&response), "r"(&now) : "memory");
+  }
+  __asm__ __volatile__("" : : "r"(late));
+  return now_ns() - start;
+}
+
+static int64_t bench_int64(long ops, void *arg)
+{
+  int64_t next = 1000000000000LL, now = 1000500000000LL, period = 1400000;
+  int64_t rel_deadline = 1000000, deadline, response;
+  int late = 0;
+  int64_t start = now_ns();
+  long i;
+
+  (void)arg;
+  for (i = 0; i < ops; i++)
+  {
+    next += period;
+    deadline = next + rel_deadline;
+    late += deadline < now;
+    response = now - next;
+    __asm__ __volatile__("" : "+m"(next), "+m"(now), "+m"(response));
+  }
+  __asm__ __volatile__("" : : "r"(late));
+  return now_ns() - start;
+}
+
+// --- Mutexes ---
+
+struct mutex_bench
+{
+  pthread_mutex_t m;
+  sem_t go;          // the contender tries to lock after this
+  sem_t done;        // the contender has unlocked
+  long ops;
+  int with_mutex;    // 0: semaphore round trip only (baseline)
+  int srp;           // lock the SRP resource instead of m
+};
+
+// The SRP resource, shared by the benchmark thread (task 0) and the
+// contender (task 1, one level above, like their SCHED_FIFO priorities)
+static struct periodic_data srp_tasks[2] = {{.prio = 0}, {.prio = 1}};
+static struct resource srp_resource = {.id = 1, .ceiling = 1};
+static struct task_set srp_set = {2, srp_tasks, 1, &srp_resource};
+
+static void bench_lock(struct mutex_bench *b, int task)
+{
+  if (b->srp)
+    srp_lock(&srp_tasks[task], &srp_resource);
+  else
+    pthread_mutex_lock(&b->m);
+}
+
+static void bench_unlock(struct mutex_bench *b, int task)
+{
+  if (b->srp)
+    srp_unlock(&srp_tasks[task], &srp_resource);
+  else
+    pthread_mutex_unlock(&b->m);
+}
+
+static int init_mutex(pthread_mutex_t *m, int protocol)
+{
+  pthread_mutexattr_t attr;
+  int err;
+
+  pthread_mutexattr_init(&attr);
+  pthread_mutexattr_setprotocol(&attr, protocol);
+  if (protocol == PTHREAD_PRIO_PROTECT)
+    pthread_mutexattr_setprioceiling(&attr, BENCH_PRIO + 1);
+  err = pthread_mutex_init(m, &attr);
+  pthread_mutexattr_destroy(&attr);
+  return err;
+}
+
+static int64_t bench_uncontended(long ops, void *arg)
+{
+  struct mutex_bench *b = arg;
+  int64_t start = now_ns();
+  long i;
+
+  for (i = 0; i < ops; i++)
+  {
+    bench_lock(b, 0);
+    bench_unlock(b, 0);
+  }
+  return now_ns() - start;
+}
+
+// Higher-priority thread: every time it is posted, it locks the mutex the
+// benchmark thread holds, so the lock blocks (and, with inheritance,
+// boosts the holder) until the holder unlocks and hands it over. Under
+// SRP every post is a job release: it waits at the gate instead, and
+// raises the holder to the ceiling
+static void *contender(void *arg)
+{
+  struct mutex_bench *b = arg;
+  long i;
+
+  for (i = 0; i < b->ops; i++)
+  {
+    sem_wait(&b->go);
+    if (b->srp)
+      srp_gate(&srp_tasks[1]);
+    if (b->with_mutex)
+    {
+      bench_lock(b, 1);
+      bench_unlock(b, 1);
+    }
+    sem_post(&b->done);
+  }
+  return NULL;
+}
+
+static int64_t bench_contended(long ops, void *arg)
+{
+  struct mutex_bench *b = arg;
+  pthread_attr_t attr;
+  struct sched_param p = {BENCH_PRIO + 1};
+  pthread_t th;
+  int64_t start;
+  long i;
+
+  b->ops = ops;
+  sem_init(&b->go, 0, 0);
+  sem_init(&b->done, 0, 0);
+  pthread_attr_init(&attr);
+  if (realtime)
+  {
+    pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+    pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+    pthread_attr_setschedparam(&attr, &p);
+  }
+  if (pthread_create(&th, &attr, contender, b) != 0)
+  {
+    perror("pthread_create");
+    exit(1);
+  }
+  pthread_attr_destroy(&attr);
+
+  start = now_ns();
+  for (i = 0; i < ops; i++)
+  {
+    if (b->with_mutex)
+      bench_lock(b, 0);
+    sem_post(&b->go);
+    if (b->with_mutex)
+      bench_unlock(b, 0);
+    sem_wait(&b->done);
+  }
+  start = now_ns() - start;
+  pthread_join(th, NULL);
+  sem_destroy(&b->go);
+  sem_destroy(&b->done);
+  return start;
+}
+
+static void mutex_benchmarks(void)
+{
+  static const struct
+  {
+    const char *name;
+    int protocol;
+  } protocols[] = {{"none", PTHREAD_PRIO_NONE},
+                   {"inherit", PTHREAD_PRIO_INHERIT},
+                   {"protect", PTHREAD_PRIO_PROTECT}};
+  struct mutex_bench b;
+  char name[64];
+  size_t p;
+
+  memset(&b, 0, sizeof(b));
+  for (p = 0; p < sizeof(protocols) / sizeof(protocols[0]); p++)
+  {
+    if (protocols[p].protocol == PTHREAD_PRIO_PROTECT && !realtime)
+    {
+      fprintf(stderr, "Skipping PTHREAD_PRIO_PROTECT: it needs SCHED_FIFO (run as root)\n");
+      continue;
+    }
+    if (init_mutex(&b.m, protocols[p].protocol) != 0)
+    {
+      fprintf(stderr, "Cannot create a mutex with protocol %s\n", protocols[p].name);
+      continue;
+    }
+    snprintf(name, sizeof(name), "mutex lock+unlock (%s)", protocols[p].name);
+    run(name, base_ops / 10, bench_uncontended, &b);
+    b.with_mutex = 1;
+    snprintf(name, sizeof(name), "mutex contended round (%s)", protocols[p].name);
+    run(name, base_ops / 100, bench_contended, &b);
+    pthread_mutex_destroy(&b.m);
+  }
+
+  // The same pairs and round with the SRP lock; the holder is only
+  // raised (and restored) in the contended round
+  srp_init(&srp_set, BENCH_PRIO);
+  b.srp = 1;
+  run("srp lock+unlock", base_ops / 10, bench_uncontended, &b);
+  b.with_mutex = 1;
+  run("srp contended round", base_ops / 100, bench_contended, &b);
+  b.srp = b.with_mutex = 0;
+  run("semaphore round (baseline)", base_ops / 100, bench_contended, &b);
+}
+
+// --- clock_nanosleep: how late an absolute sleep of interval_ns wakes up.
+// Every sample is one wake-up, so this is a distribution of latencies ---
+
+static void sleep_benchmark(int64_t interval_ns, int samples)
+{
+  double late[samples];
+  struct bench_stats s;
+  struct timespec t;
+  char name[64];
+  int i;
+
+  for (i = 0; i < samples; i++)
+  {
+    int64_t target;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    target = (int64_t)t.tv_sec * 1000000000 + t.tv_nsec + interval_ns;
+    t.tv_sec = target / 1000000000;
+    t.tv_nsec = target % 1000000000;
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &t, NULL);
+    late[i] = (double)(now_ns() - target);
+  }
+  summarize(late, samples, &s);
+  snprintf(name, sizeof(name), "clock_nanosleep %lld us (lateness)",
+           (long long)(interval_ns / 1000));
+  print_row(name, samples, 1, &s);
+}
+
+static void usage(const char *name)
+{
+  fprintf(stderr, "Usage: %s [-r reps] [-n ops] [-c]\n", name);
+  exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+  struct sched_param p = {BENCH_PRIO};
+  cpu_set_t cpus;
+  clockid_t id;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "r:n:c")) != -1)
+  {
+    switch (opt)
+    {
+    case 'r':
+      reps = atoi(optarg);
+      break;
+    case 'n':
+      base_ops = atol(optarg);
+      break;
+    case 'c':
+      csv = 1;
+      break;
+    default:
+      usage(argv[0]);
+    }
+  }
+  if (reps <= 0 || base_ops < 100)
+    usage(argv[0]);
+
+  // Same conditions as the periodic threads: no page faults, one CPU (the
+  // contender preempts the holder instead of spinning elsewhere) and
+  // fixed priorities
+  if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+    fprintf(stderr, "Warning: mlockall failed (%s)\n", strerror(errno));
+  CPU_ZERO(&cpus);
+  CPU_SET(sched_getcpu() >= 0 ? sched_getcpu() : 0, &cpus);
+  if (sched_setaffinity(0, sizeof(cpus), &cpus) != 0)
+    fprintf(stderr, "Warning: cannot pin to one CPU (%s)\n", strerror(errno));
+  realtime = pthread_setschedparam(pthread_self(), SCHED_FIFO, &p) == 0;
+  if (!realtime)
+    fprintf(stderr, "Warning: not running under SCHED_FIFO, results include preemptions\n");
+
+  print_header();
+  id = CLOCK_MONOTONIC;
+  run("clock_gettime(MONOTONIC)", base_ops, bench_clock, &id);
+  id = CLOCK_THREAD_CPUTIME_ID;
+  run("clock_gettime(THREAD_CPUTIME_ID)", base_ops, bench_clock, &id);
+  run("release step, timespec", base_ops * 10, bench_timespec, NULL);
+  run("release step, int64 ns", base_ops * 10, bench_int64, NULL);
+  mutex_benchmarks();
+  sleep_benchmark(100000, reps * 20);
+  sleep_benchmark(1000000, reps * 10);
+  return 0;
+}
@@ -0,0 +1,202 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sched.h>
+#include "timespec_operations.h"
+#include "partition.h"
+
+// CPUs the process may run on, in increasing order (partition_ncpus)
+static int allowed[CPU_SETSIZE];
+static int nallowed = -1;
+
+static double utilization(const struct periodic_data *d)
+{
+  struct timespec c = taskset_wcet(d);
+
+  return t2d(c) / t2d(d->period);
+}
+
+int partition_parse(const char *name, partition_heuristic *h)
+{
+  if (strcmp(name, "ff") == 0)
+    *h = PARTITION_FF;
+  else if (strcmp(name, "ffd") == 0)
+    *h = PARTITION_FFD;
+  else if (strcmp(name, "wfd") == 0)
+    *h = PARTITION_WFD;
+  else
+    return -1;
+  return 0;
+}
+
+// qsort helper: decreasing utilization
+static int by_utilization(const void *a, const void *b)
+{
+  double ua = utilization(*(struct periodic_data *const *)a);
+  double ub = utilization(*(struct periodic_data *const *)b);
+
+  return (ua < ub) - (ua > ub);
+}
+
+int partition_assign(struct task_set *ts, partition_heuristic h, int ncpus)
+{
+  struct periodic_data **order = malloc(ts->ntasks * sizeof(*order));
+  double load[ncpus];
+  int n = 0, i, c;
+
+  memset(load, 0, sizeof(load));
+  for (i = 0; i < ts->ntasks; i++)
+  {
+    struct periodic_data *d = &ts->tasks[i];
+
+    if (d->cpu >= ncpus)
+    {
+      fprintf(stderr, "Task %d is pinned to CPU %d, but there are %d CPUs\n",
+              d->id, d->cpu, ncpus);
+      free(order);
+      return -1;
+    }
+    if (d->cpu >= 0)
+      load[d->cpu] += utilization(d);
+    else
+      order[n++] = d;
+  }
+  if (h != PARTITION_FF)
+  {
+    qsort(order, n, sizeof(*order), by_utilization);
+  }
+
+  for (i = 0; i < n; i++)
+  {
+    double u = utilization(order[i]);
+    int best = -1;
+
+    for (c = 0; c < ncpus; c++)
+    {
+      if (load[c] + u > 1.0)
+        continue;
+      if (best < 0 || (h == PARTITION_WFD && load[c] < load[best]))
+        best = c;
+      if (h != PARTITION_WFD)
+        break;
+    }
+    if (best < 0)
+    {
+      fprintf(stderr, "Task %d (U=%.3f) does not fit on any of the %d CPUs\n",
+              order[i]->id, u, ncpus);
+      free(order);
+      return -1;
+    }
+    order[i]->cpu = best;
+    load[best] += u;
+  }
+
+  free(order);
+  return 0;
+}
+
+int partition_mark_global(struct task_set *ts)
+{
+  int first_cpu[ts->nresources + 1];
+  int i, k, nglobal = 0;
+
+  for (k = 0; k < ts->nresources; k++)
+  {
+    first_cpu[k] = -2;
+    ts->resources[k].global = 0;
+  }
+  for (i = 0; i < ts->ntasks; i++)
+  {
+    const struct periodic_data *d = &ts->tasks[i];
+
+    for (k = 0; k < d->nsegments; k++)
+    {
+      int r = d->segments[k].resource - 1;
+
+      if (d->segments[k].kind != SEGMENT_LOCK)
+        continue;
+      if (first_cpu[r] == -2)
+        first_cpu[r] = d->cpu;
+      else if (first_cpu[r] != d->cpu && !ts->resources[r].global)
+      {
+        ts->resources[r].global = 1;
+        nglobal++;
+      }
+    }
+  }
+  return nglobal;
+}
+
+void partition_print(const struct task_set *ts, int ncpus)
+{
+  int i, c, k;
+
+  for (c = 0; c < ncpus; c++)
+  {
+    double u = 0;
+
+    for (i = 0; i < ts->ntasks; i++)
+    {
+      if (ts->tasks[i].cpu == c)
+        u += utilization(&ts->tasks[i]);
+    }
+    printf("CPU %d: U = %.3f, tasks", c, u);
+    for (i = 0; i < ts->ntasks; i++)
+    {
+      if (ts->tasks[i].cpu == c)
+        printf(" %d", ts->tasks[i].id);
+    }
+    printf("\n");
+  }
+  for (k = 0; k < ts->nresources; k++)
+  {
+    if (ts->resources[k].global)
+      printf("R%d is global (MPCP)\n", ts->resources[k].id);
+  }
+}
+
+int partition_ncpus(void)
+{
+  cpu_set_t set;
+  int c;
+
+  if (nallowed >= 0)
+    return nallowed;
+  nallowed = 0;
+  if (sched_getaffinity(0, sizeof(set), &set) != 0)
+  {
+    // Unknown affinity: every online CPU
+    CPU_ZERO(&set);
+    for (c = 0; c < (int)sysconf(_SC_NPROCESSORS_ONLN) && c < CPU_SETSIZE; c++)
+      CPU_SET(c, &set);
+  }
+  for (c = 0; c < CPU_SETSIZE; c++)
+  {
+    if (CPU_ISSET(c, &set))
+      allowed[nallowed++] = c;
+  }
+  return nallowed;
+}
+
+int partition_set_affinity(pthread_attr_t *attr, int cpu)
+{
+  cpu_set_t set;
+
+  // Unpinned: the CPUs of the calling thread, which may already be
+  // restricted (taskset, a cpuset, or the single CPU of -p srp)
+  if (cpu < 0)
+  {
+    if (pthread_getaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+      return -1;
+  }
+  else
+  {
+    if (cpu >= partition_ncpus())
+      return -1;
+    CPU_ZERO(&set);
+    CPU_SET(allowed[cpu], &set);
+  }
+  return pthread_attr_setaffinity_np(attr, sizeof(set), &set);
+}
@@ -0,0 +1,49 @@
+#ifndef _PARTITION_H
+#define _PARTITION_H
+
+#include <pthread.h>
+#include "taskset.h"
+
+/**
+ * @file partition.h
+ *
+ * Partitioned fixed-priority scheduling: every task is assigned to one
+ * CPU with a utilization-based bin-packing heuristic and pinned there.
+ * Resources used from more than one CPU are global and are handled as in
+ * MPCP: their critical sections run at a priority above every task
+ * priority, so they are never preempted by local work, and the waiting
+ * threads suspend in the mutex's priority-ordered queue.
+ **/
+
+typedef enum
+{
+  PARTITION_FF,  // first-fit, in task-set order
+  PARTITION_FFD, // first-fit decreasing utilization
+  PARTITION_WFD  // worst-fit decreasing utilization (balances the load)
+} partition_heuristic;
+
+// Parse "ff", "ffd" or "wfd"; -1 if unknown
+extern int partition_parse(const char *name, partition_heuristic *h);
+
+// Assign every task without a cpu= to one of ncpus CPUs, keeping the
+// utilization of each CPU <= 1. Tasks with cpu= keep theirs. Prints the
+// first task that does not fit and returns -1
+extern int partition_assign(struct task_set *ts, partition_heuristic h, int ncpus);
+
+// Mark the resources used by tasks on different CPUs as global.
+// Returns the number of global resources
+extern int partition_mark_global(struct task_set *ts);
+
+// Print the utilization and the tasks of every CPU
+extern void partition_print(const struct task_set *ts, int ncpus);
+
+// Number of CPUs the process may run on, from its affinity at the first
+// call (taskset, cpusets). The CPU numbers of the task set (cpu=, -P, -n)
+// index this list: CPU c is the c-th allowed CPU of the system
+extern int partition_ncpus(void);
+
+// Pin the threads created with attr to CPU cpu of the list above (the
+// CPUs of the calling thread if cpu < 0)
+extern int partition_set_affinity(pthread_attr_t *attr, int cpu);
+
+#endif
@@ -1,242 +1,696 @@
+#define _GNU_SOURCE // pthread_tryjoin_np, sched_getcpu
 #include <stdlib.h>
 #include <stdio.h>
 #include <time.h>
 #include <pthread.h>
 #include <unistd.h>
 #include <string.h>
+#include <signal.h>
+#include <errno.h>
+#include <stdatomic.h>
 #include "timespec_operations.h"
 #include "eat.h"
-
-static struct timespec initial_time;
-
-// Structure containing the parameters of each periodic thread
-struct periodic_data
+#include "trace.h"
+#include "taskset.h"
+#include "analysis.h"
+#include "locks.h"
+#include "partition.h"
+#include "srp.h"
+#include "sim.h"
+#include "rtinit.h"
+#include "edf.h"
+#include "dispatch.h"
+#include "metrics.h"
+#include "workload.h"
+#include "load.h"
+
+// Time from the start of the run controller to the common first release,
+// enough to create the threads and prefault their stacks
+#define START_DELAY_NS 100000000
+
+// Signal sent to the periodic threads to cut short their sleep when the
+// run is stopped early
+#define WAKE_SIGNAL SIGUSR2
+
+static struct timespec initial_time; // common release instant of every task
+static struct timespec warmup_end;   // jobs released before are not measured
+static struct timespec run_end;      // no job is released from here on
+static int bounded_run;              // run_end is set
+static atomic_int stopping;          // SIGINT or SIGTERM received
+static int edf_mode;                 // threads run under SCHED_DEADLINE
+static int dispatching;              // jobs run by the dispatcher's workers
+static int use_srp;                  // resources locked with srp.h
+static pthread_barrier_t start_barrier;
+static overrun_policy on_overrun = OVERRUN_CATCH_UP;
+
+// Convert a timespec to nanoseconds for the trace events
+static inline int64_t timespec_ns(const struct timespec *t)
 {
-  struct timespec period;   // period
-  struct timespec wcet1;    // first part of worst-case execution time (before mutexes)
-  struct timespec wcet2;    // middle part of execution time (between mutexes)
-  struct timespec wcet3;    // last part of execution time (after mutexes)
-  struct timespec wcetmut1; // worst-case execution time with mutex1 (R1) locked
-  struct timespec wcetmut2; // worst-case execution time with mutex2 (R2) locked
-  struct timespec phase;    // initial phase to start the thread
-  struct timespec wcrt;     // worst-case response time
-  pthread_mutex_t *mutex1;  // pointer to first mutex (R1)
-  pthread_mutex_t *mutex2;  // pointer to second mutex (R2)
-  int mutex_order;          // order of mutex acquisition: 1=R1->R2, 2=R2->R1
-  int id;                   // thread identifier
-};
-
-typedef enum
+  return (int64_t)t->tv_sec * 1000000000 + t->tv_nsec;
+}
+
+// Sleep until the absolute time t. Returns -1 if the run is being stopped
+static int sleep_until(const struct timespec *t)
 {
-  YES,
-  NO
-} protocol_usage;
+  int err;
 
-// Show a message with the relative elapsed time, and response_time
-void report(char *message, int id, struct timespec *response_time)
+  while ((err = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, t, NULL)) == EINTR)
+  {
+    if (atomic_load(&stopping))
+      return -1;
+  }
+  if (err != 0)
+  {
+    printf("Error in clock_nanosleep: %s\n", strerror(err));
+    pthread_exit(NULL);
+  }
+  return 0;
+}
+
+// Run one job of d released at release: execute its body and record the
+// release jitter, the response time, the lateness and the worst case. A
+// deadlock victim only counts as aborted (and late, if it is): its partial
+// response time is left out. *end receives the completion time
+static void run_job(struct periodic_data *d, const struct timespec *release,
+                    struct timespec *end)
 {
-  struct timespec now;
+  struct timespec response_time, start_time, deadline, now, t;
+  const struct segment *s, *last = d->segments + d->nsegments;
+  int aborted, steady, faulty;
+
+  // Jobs released during the warm-up are traced but left out of the
+  // statistics and of the worst-case response time
+  steady = smaller_or_equal_timespec(&warmup_end, release);
+
+  // SRP: the job starts once its priority is above the system ceiling;
+  // the wait is part of its release jitter, like a ceiling under pcp
+  if (use_srp)
+    srp_gate(d);
+
+  clock_gettime(CLOCK_MONOTONIC, &start_time);
+  decr_timespec(&start_time, release);
+  if (steady)
+    hist_record(&d->stats->release_jitter, timespec_ns(&start_time));
+  trace_emit(d->trace, TRACE_JOB_START, d->id, 0, 0);
+  faulty = workload_job(d);
+
+  // Execute the job body: compute, lock and unlock segments in order
+  add_timespec(&deadline, release, &d->deadline);
+  aborted = 0;
+  for (s = d->segments; s < last && !aborted; s++)
+  {
+    // Abort policy: give up at the first segment boundary past the
+    // deadline (a segment in progress is never interrupted)
+    if (on_overrun == OVERRUN_ABORT)
+    {
+      clock_gettime(CLOCK_MONOTONIC, &now);
+      if smaller_timespec (&deadline, &now)
+      {
+        resource_unlock_all(d);
+        stats_count(&d->stats->aborted, steady);
+        break;
+      }
+    }
+    switch (s->kind)
+    {
+    case SEGMENT_COMPUTE:
+      t = workload_time(d, s, faulty);
+      if (s->load == LOAD_SPIN)
+        eat(&t);
+      else
+        load_run(d, s, &t);
+      break;
+    case SEGMENT_LOCK:
+      trace_emit(d->trace, TRACE_LOCK_TRY, d->id, s->resource, 0);
+      if (resource_lock(d, s->res) != 0)
+      {
+        // Deadlock victim: give back what we hold and abandon the job
+        resource_unlock_all(d);
+        stats_count(&d->stats->aborted, steady);
+        aborted = 1;
+        break;
+      }
+      trace_emit(d->trace, TRACE_LOCK_ACQUIRED, d->id, s->resource, 0);
+      break;
+    case SEGMENT_UNLOCK:
+      resource_unlock(d, s->res);
+      trace_emit(d->trace, TRACE_LOCK_RELEASED, d->id, s->resource, 0);
+      break;
+    }
+  }
+
   clock_gettime(CLOCK_MONOTONIC, &now);
-  decr_timespec(&now, &initial_time);
-  printf("%3.3f - %s - %d", (double)(now.tv_sec + now.tv_nsec / 1.0e9), message, id);
-  if (response_time == NULL)
+  response_time = now;
+  decr_timespec(&response_time, release);
+  trace_emit(d->trace, TRACE_JOB_END, d->id, 0, timespec_ns(&response_time));
+  if (steady && !aborted)
+    hist_record(&d->stats->response, timespec_ns(&response_time));
+
+  if smaller_timespec (&deadline, &now)
+  {
+    struct timespec late = now;
+
+    decr_timespec(&late, &deadline);
+    trace_emit(d->trace, TRACE_DEADLINE_MISS, d->id, 0, timespec_ns(&late));
+    if (steady)
+      hist_record(&d->stats->lateness, timespec_ns(&late));
+  }
+
+  if (d->metrics != NULL && !aborted)
   {
-    printf("\n");
+    metrics_job(d->metrics, timespec_ns(release), timespec_ns(&response_time),
+                smaller_timespec(&deadline, &now));
   }
-  else
+
+  if (steady && !aborted && smaller_timespec(&d->wcrt, &response_time))
   {
-    printf(" - %3.3f\n", (double)(response_time->tv_sec +
-                                  response_time->tv_nsec / 1.0e9));
+    d->wcrt = response_time;
+    trace_emit(d->trace, TRACE_WCRT, d->id, 0, timespec_ns(&d->wcrt));
   }
+  *end = now;
 }
 
-// Periodic thread using nanosleep
+// Periodic thread using nanosleep. Returns once the next release would be
+// at or after run_end, or when the run is stopped
 void *periodic(void *arg)
 {
   struct periodic_data *d = (struct periodic_data *)arg;
   struct timespec next_time = initial_time;
-  struct timespec response_time;
-  int err;
+  struct timespec now;
+  uint64_t skipped;
+  int steady, err;
 
   d->wcrt.tv_sec = d->wcrt.tv_nsec = 0;
+  rt_prefault_stack();
+
+  // The thread is created SCHED_FIFO and switches itself to EDF
+  if (edf_mode && (err = edf_set_deadline(d)) != 0)
+  {
+    printf("Task %d: SCHED_DEADLINE (runtime %.3f ms) refused: %s%s\n", d->id,
+           edf_runtime(d) / 1.0e6, strerror(err),
+           err == EBUSY    ? " (bandwidth above /proc/sys/kernel/sched_rt_runtime_us)"
+           : err == EINVAL ? " (see /proc/sys/kernel/sched_deadline_period_max_us)"
+                           : "");
+    exit(1);
+  }
 
+  // Every thread is created and ready before the common first release
+  pthread_barrier_wait(&start_barrier);
   incr_timespec(&next_time, &d->phase);
-  if ((err = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next_time, NULL)) != 0)
+  if ((bounded_run && !smaller_timespec(&next_time, &run_end)) || sleep_until(&next_time) != 0)
   {
-    printf("Error in clock_nanosleep: %s\n", strerror(err));
-    pthread_exit(NULL);
+    return NULL;
   }
 
   while (1)
   {
-    report("Start thread ", d->id, NULL);
-    eat(&d->wcet1);
+    steady = smaller_or_equal_timespec(&warmup_end, &next_time);
+    run_job(d, &next_time, &now);
 
-    if (d->mutex1 && d->mutex2)
+    // After an overrun the next release is already in the past: catch-up
+    // runs it at once, skip moves on to the first release still ahead
+    incr_timespec(&next_time, &d->period);
+    if (on_overrun == OVERRUN_SKIP)
     {
-      if (d->mutex_order == 1)
+      for (skipped = 0; smaller_timespec(&next_time, &now); skipped++)
       {
-        report("Thread trying to lock R1", d->id, NULL);
-        pthread_mutex_lock(d->mutex1);
-        report("Thread acquired R1", d->id, NULL);
-        eat(&d->wcetmut1);
-
-        report("Thread trying to lock R2", d->id, NULL);
-        pthread_mutex_lock(d->mutex2);
-        report("Thread acquired R2", d->id, NULL);
-        eat(&d->wcetmut2);
-
-        pthread_mutex_unlock(d->mutex2);
-        report("Thread released R2", d->id, NULL);
-        pthread_mutex_unlock(d->mutex1);
-        report("Thread released R1", d->id, NULL);
-      }
-      else
-      {
-        report("Thread trying to lock R2", d->id, NULL);
-        pthread_mutex_lock(d->mutex2);
-        report("Thread acquired R2", d->id, NULL);
-        eat(&d->wcetmut2);
-
-        report("Thread trying to lock R1", d->id, NULL);
-        pthread_mutex_lock(d->mutex1);
-        report("Thread acquired R1", d->id, NULL);
-        eat(&d->wcetmut1);
-
-        pthread_mutex_unlock(d->mutex1);
-        report("Thread released R1", d->id, NULL);
-        pthread_mutex_unlock(d->mutex2);
-        report("Thread released R2", d->id, NULL);
+        incr_timespec(&next_time, &d->period);
       }
+      stats_count(&d->stats->skipped, steady ? skipped : 0);
     }
-    else if (d->mutex1)
+    if (atomic_load(&stopping) || (bounded_run && !smaller_timespec(&next_time, &run_end)) ||
+        sleep_until(&next_time) != 0)
     {
-      pthread_mutex_lock(d->mutex1);
-      eat(&d->wcetmut1);
-      pthread_mutex_unlock(d->mutex1);
+      return NULL;
     }
+  }
+}
 
-    eat(&d->wcet2);
-    eat(&d->wcet3);
+// Length of a simulation or of a run, "<seconds>" or "<n>h" hyperperiods,
+// in nanoseconds
+static int64_t parse_length(const char *length, int64_t hyperperiod)
+{
+  char *end;
+  double n = strtod(length, &end);
 
-    clock_gettime(CLOCK_MONOTONIC, &response_time);
-    decr_timespec(&response_time, &next_time);
-    report("End   thread ", d->id, &response_time);
+  if (n <= 0 || (*end != '\0' && strcmp(end, "h") != 0))
+  {
+    fprintf(stderr, "Bad length '%s' (seconds, or hyperperiods with an 'h' suffix)\n", length);
+    exit(1);
+  }
+  if (*end == 'h')
+  {
+    if (hyperperiod < 0 || n * hyperperiod > INT64_MAX / 2)
+    {
+      fprintf(stderr, "The hyperperiod is too long\n");
+      exit(1);
+    }
+    return (int64_t)(n * hyperperiod);
+  }
+  return (int64_t)(n * 1.0e9);
+}
 
-    if smaller_timespec (&d->wcrt, &response_time)
+// Simulate the task set for length ("<seconds>" or "<n>h" hyperperiods)
+// and compare the simulated worst-case response times with the bounds;
+// every event is printed too if trace is set
+static void simulate(struct task_set *ts, const struct analysis *an,
+                     analysis_protocol protocol, const char *length, int trace)
+{
+  struct sim_config cfg;
+  struct sim_result r;
+  struct timespec t0, t1;
+  int64_t hyperperiod = taskset_hyperperiod(ts);
+  int i;
+
+  cfg.protocol = protocol;
+  cfg.overrun = on_overrun;
+  cfg.trace = trace;
+  cfg.duration = parse_length(length, hyperperiod);
+
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  if (sim_run(ts, &cfg, &r) != 0)
+  {
+    printf("Error while simulating the task set\n");
+    exit(1);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  decr_timespec(&t1, &t0);
+
+  if (hyperperiod > 0)
+    printf("Hyperperiod: %.3f s\n", hyperperiod / 1.0e9);
+  sim_print(ts, &r);
+  printf("Simulation time: %.3f ms\n", t2d(t1) * 1000.0);
+  for (i = 0; i < ts->ntasks; i++)
+  {
+    ts->tasks[i].wcrt.tv_sec = r.tasks[i].wcrt / 1000000000;
+    ts->tasks[i].wcrt.tv_nsec = r.tasks[i].wcrt % 1000000000;
+  }
+  analysis_print_measured(ts, an, protocol);
+  sim_free(&r);
+}
+
+// Nothing to do: the signal only interrupts clock_nanosleep
+static void wake(int sig)
+{
+  (void)sig;
+}
+
+// Task whose job thread i is running: its own with a thread per task,
+// NULL if none
+static struct periodic_data *running_task(struct task_set *ts, int i)
+{
+  return dispatching ? dispatch_running(i) : &ts->tasks[i];
+}
+
+// Run controller: release every thread at once, wait for the end of the
+// run (forever if unbounded) or for one of stop_signals, and join the
+// nthreads threads as they return. A thread still blocked on a resource
+// when all the others are (a deadlock) is left behind. Returns how many
+// were
+static int run(struct task_set *ts, int nthreads, const pthread_t *threads,
+               const sigset_t *stop_signals)
+{
+  struct timespec now, left, poll = {0, 100000000};
+  char joined[nthreads];
+  int remaining = nthreads, was_blocked = 0, sig, i;
+
+  pthread_barrier_wait(&start_barrier);
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  if (smaller_timespec(&initial_time, &now))
+  {
+    left = now;
+    decr_timespec(&left, &initial_time);
+    printf("Warning: first release delayed by %.3f ms\n", t2d(left) * 1000.0);
+  }
+
+  do
+  {
+    if (bounded_run)
+    {
+      clock_gettime(CLOCK_MONOTONIC, &now);
+      if (!smaller_timespec(&now, &run_end))
+      {
+        sig = -1;
+        break;
+      }
+      left = run_end;
+      decr_timespec(&left, &now);
+      sig = sigtimedwait(stop_signals, NULL, &left);
+    }
+    else
     {
-      d->wcrt = response_time;
-      report("Worst-case response time ", d->id, &d->wcrt);
+      sig = sigwaitinfo(stop_signals, NULL);
     }
+  } while (sig < 0 && errno == EINTR);
 
-    incr_timespec(&next_time, &d->period);
-    if ((err = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next_time, NULL)) != 0)
+  // Stop early: no more releases, and the threads sleeping for their next
+  // one wake up now (a job in progress is always completed)
+  if (sig > 0)
+  {
+    printf("Stopping on signal %d\n", sig);
+    atomic_store(&stopping, 1);
+    for (i = 0; i < nthreads; i++)
     {
-      printf("Error in clock_nanosleep: %s\n", strerror(err));
-      pthread_exit(NULL);
+      pthread_kill(threads[i], WAKE_SIGNAL);
     }
   }
+
+  memset(joined, 0, sizeof(joined));
+  while (1)
+  {
+    int blocked = 1;
+
+    for (i = 0; i < nthreads; i++)
+    {
+      struct periodic_data *d;
+
+      if (joined[i])
+        continue;
+      if (pthread_tryjoin_np(threads[i], NULL) == 0)
+      {
+        joined[i] = 1;
+        remaining--;
+      }
+      else if ((d = running_task(ts, i)) == NULL || atomic_load(&d->waiting_for) < 0)
+      {
+        blocked = 0;
+      }
+    }
+    // Blocked twice in a row, 100 ms apart, so that a lock that is just
+    // being taken is not mistaken for a deadlock
+    if (remaining == 0 || (blocked && was_blocked))
+      break;
+    was_blocked = blocked;
+    clock_nanosleep(CLOCK_MONOTONIC, 0, &poll, NULL);
+  }
+  for (i = 0; i < nthreads; i++)
+  {
+    struct periodic_data *d = running_task(ts, i);
+    int want;
+
+    if (joined[i] || d == NULL)
+      continue;
+    // It may have got the lock since the last poll
+    want = atomic_load(&d->waiting_for);
+    if (want >= 0)
+      printf("Task %d did not stop: blocked on R%d\n", d->id, ts->resources[want].id);
+    else
+      printf("Task %d did not stop: running\n", d->id);
+    // The other tasks of its level cannot run either
+    if (dispatching)
+      dispatch_print_queued(stdout, i);
+  }
+  return remaining;
 }
 
-// Main program that creates four periodic threads
-int main()
+// Main program that creates one periodic thread per task of the task-set file
+int main(int argc, char *argv[])
 {
-  pthread_t t1, t2, t3, t4;
+  pthread_t *threads;
   struct sched_param sch_param;
   pthread_attr_t attr;
-  pthread_mutex_t mutex1, mutex2; // R1 and R2
-  pthread_mutexattr_t mutexattr1, mutexattr2;
-  struct periodic_data data1, data2, data3, data4;
-
-  const protocol_usage PROTOCOL = YES; // Change to YES to avoid deadlock
-
-  // set data for all threads
-
-  // Thread τ₁: C=0.15s, C_R1=0.025s, C_R2=0.025s (total 0.05s in mutexes = 33%), T=1.4s
-  // Distribution: before=0.03s (20%), R1=0.025s, R2=0.025s, between=0.01s, after=0.06s
-  // Order: R1 -> R2 (mutex_order=1)
-  data1.period.tv_sec = 1;
-  data1.period.tv_nsec = 400000000;
-  data1.wcet1.tv_sec = 0;
-  data1.wcet1.tv_nsec = 30000000; // 0.03s before mutexes (20% of C)
-  data1.wcet2.tv_sec = 0;
-  data1.wcet2.tv_nsec = 10000000; // 0.01s between mutexes
-  data1.wcet3.tv_sec = 0;
-  data1.wcet3.tv_nsec = 60000000; // 0.06s after mutexes
-  data1.wcetmut1.tv_sec = 0;
-  data1.wcetmut1.tv_nsec = 25000000; // 0.025s in R1
-  data1.wcetmut2.tv_sec = 0;
-  data1.wcetmut2.tv_nsec = 25000000; // 0.025s in R2
-  data1.phase.tv_sec = 0;
-  data1.phase.tv_nsec = 0; // Start immediately to create deadlock condition
-  data1.mutex1 = &mutex1;  // R1
-  data1.mutex2 = &mutex2;  // R2
-  data1.mutex_order = 1;   // Order: R1 -> R2
-  data1.id = 1;
-
-  // Thread τ₂: C=0.6s, no mutex, T=2.9s
-  // Distribution: split in three parts
-  data2.period.tv_sec = 2;
-  data2.period.tv_nsec = 900000000;
-  data2.wcet1.tv_sec = 0;
-  data2.wcet1.tv_nsec = 200000000; // 0.2s
-  data2.wcet2.tv_sec = 0;
-  data2.wcet2.tv_nsec = 200000000; // 0.2s
-  data2.wcet3.tv_sec = 0;
-  data2.wcet3.tv_nsec = 200000000; // 0.2s
-  data2.wcetmut1.tv_sec = 0;
-  data2.wcetmut1.tv_nsec = 0;
-  data2.wcetmut2.tv_sec = 0;
-  data2.wcetmut2.tv_nsec = 0;
-  data2.phase.tv_sec = 0;
-  data2.phase.tv_nsec = 50000000; // 0.05s phase
-  data2.mutex1 = NULL;
-  data2.mutex2 = NULL;
-  data2.mutex_order = 0;
-  data2.id = 2;
-
-  // Thread τ₃: C=2.7s, no mutex, T=13.0s
-  // Distribution: split in three parts
-  data3.period.tv_sec = 13;
-  data3.period.tv_nsec = 0;
-  data3.wcet1.tv_sec = 0;
-  data3.wcet1.tv_nsec = 900000000; // 0.9s
-  data3.wcet2.tv_sec = 0;
-  data3.wcet2.tv_nsec = 900000000; // 0.9s
-  data3.wcet3.tv_sec = 0;
-  data3.wcet3.tv_nsec = 900000000; // 0.9s
-  data3.wcetmut1.tv_sec = 0;
-  data3.wcetmut1.tv_nsec = 0;
-  data3.wcetmut2.tv_sec = 0;
-  data3.wcetmut2.tv_nsec = 0;
-  data3.phase.tv_sec = 0;
-  data3.phase.tv_nsec = 60000000; // 0.06s phase
-  data3.mutex1 = NULL;
-  data3.mutex2 = NULL;
-  data3.mutex_order = 0;
-  data3.id = 3;
-
-  // Thread τ₄: C=5.3s, C_R1=0.5s, C_R2=0.5s (total 1.0s in mutexes = 19%), T=50.0s
-  // Distribution: before=1.06s (20%), R2=0.5s, R1=0.5s, between=0.24s, after=3.0s
-  // Order: R2 -> R1 (mutex_order=2) - OPPOSITE to τ₁ to create DEADLOCK!
-  data4.period.tv_sec = 50;
-  data4.period.tv_nsec = 0;
-  data4.wcet1.tv_sec = 1;
-  data4.wcet1.tv_nsec = 60000000; // 1.06s before mutexes (20% of C)
-  data4.wcet2.tv_sec = 0;
-  data4.wcet2.tv_nsec = 240000000; // 0.24s between mutexes
-  data4.wcet3.tv_sec = 3;
-  data4.wcet3.tv_nsec = 0; // 3.0s after mutexes
-  data4.wcetmut1.tv_sec = 0;
-  data4.wcetmut1.tv_nsec = 500000000; // 0.5s in R1
-  data4.wcetmut2.tv_sec = 0;
-  data4.wcetmut2.tv_nsec = 500000000; // 0.5s in R2
-  data4.phase.tv_sec = 0;
-  data4.phase.tv_nsec = 10000000; // Start at 0.01s, slightly after τ₁ to create deadlock
-  data4.mutex1 = &mutex1;         // R1
-  data4.mutex2 = &mutex2;         // R2
-  data4.mutex_order = 2;          // Order: R2 -> R1 (OPPOSITE to thread 1!)
-  data4.id = 4;
+  pthread_mutexattr_t mutexattr;
+  struct task_set ts;
+  struct analysis an;
+  struct task_stats *stats;
+  sigset_t sigset;
+  const char *taskset_file = "tasks.cfg";
+  const char *stats_file = NULL;
+  int min_prio = sched_get_priority_min(SCHED_FIFO);
+  int max_prio = sched_get_priority_max(SCHED_FIFO);
+  int check_only = 0;
+  const char *sim_length = NULL;
+  int sim_trace = 0;
+  const char *run_length = NULL;
+  struct sigaction wake_action;
+  FILE *stats_out = NULL;
+  int stuck, nthreads;
+  struct dispatch_config dispatch;
+  const char *trace_file = NULL;
+  const char *metrics_name = NULL;
+  uint64_t seed = 1;
+  int64_t probe_interval = 0;
+  struct timespec warmup = {0, 0};
+  deadlock_policy on_deadlock = DEADLOCK_REPORT;
+  int partitioned = 0, pinned = 0, nglobal;
+  partition_heuristic heuristic = PARTITION_WFD;
+  int ncpus = partition_ncpus();
+  int i, opt;
+
+  analysis_protocol protocol = ANALYSIS_PCP;
+
+  // Options: -p selects the mutex protocol (pcp by default, srp for the
+  // user-space ceiling locks of srp.h, pip or none to observe the
+  // deadlock); -o selects what a thread does when a job
+  // overruns its deadline; -c only runs the schedulability analysis (exit
+  // status 2 if the task set is not schedulable); -s writes the statistics
+  // dumped on SIGUSR1 to a file instead of stdout; -d selects what to do
+  // when a deadlock is detected; -P partitions the tasks among -n CPUs with
+  // a bin-packing heuristic; -S simulates the task set in virtual time for
+  // a number of seconds (or of hyperperiods with an 'h' suffix) instead of
+  // running it, and -v prints every simulated event; -l starts a latency probe thread that wakes up every so
+  // many microseconds; -w leaves the jobs released during the first so
+  // many seconds out of the statistics; -t writes the trace to a binary
+  // file (see trace2json) instead of stdout; -r stops releasing jobs after
+  // a number of seconds (or of hyperperiods with an 'h' suffix), instead
+  // of running until SIGINT or SIGTERM; -E runs the threads under
+  // SCHED_DEADLINE (EDF) instead of fixed priorities; -D runs the jobs on
+  // one worker thread per priority level, released by a single timer,
+  // instead of one thread per task; -m publishes live metrics in a POSIX
+  // shared-memory segment with that name (see psrmon); -x seeds the
+  // random execution times and faults; the argument is the task-set file
+  while ((opt = getopt(argc, argv, "p:o:cs:d:P:n:S:vl:w:t:r:EDm:x:")) != -1)
+  {
+    switch (opt)
+    {
+    case 'v':
+      sim_trace = 1;
+      break;
+    case 'x':
+      seed = strtoull(optarg, NULL, 0);
+      break;
+    case 'm':
+      metrics_name = optarg;
+      break;
+    case 'D':
+      dispatching = 1;
+      break;
+    case 'E':
+      edf_mode = 1;
+      break;
+    case 'r':
+      run_length = optarg;
+      break;
+    case 't':
+      trace_file = optarg;
+      break;
+    case 'w':
+      if (atof(optarg) < 0)
+      {
+        fprintf(stderr, "Bad warm-up time '%s'\n", optarg);
+        exit(1);
+      }
+      warmup = d2t(atof(optarg));
+      break;
+    case 'l':
+      probe_interval = (int64_t)(atof(optarg) * 1000.0);
+      if (probe_interval <= 0)
+      {
+        fprintf(stderr, "Bad probe interval '%s' (microseconds)\n", optarg);
+        exit(1);
+      }
+      break;
+    case 'o':
+      if (taskset_parse_overrun(optarg, &on_overrun) != 0)
+      {
+        fprintf(stderr, "Unknown overrun policy '%s' (catchup, skip, abort)\n", optarg);
+        exit(1);
+      }
+      break;
+    case 'p':
+      // SRP blocks like the immediate ceiling: same bounds and simulation
+      use_srp = strcmp(optarg, "srp") == 0;
+      if (use_srp)
+        protocol = ANALYSIS_PCP;
+      else if (analysis_parse_protocol(optarg, &protocol) != 0)
+      {
+        fprintf(stderr, "Unknown protocol '%s' (pcp, srp, pip, none)\n", optarg);
+        exit(1);
+      }
+      break;
+    case 'S':
+      sim_length = optarg;
+      break;
+    case 'P':
+      if (partition_parse(optarg, &heuristic) != 0)
+      {
+        fprintf(stderr, "Unknown partitioning heuristic '%s' (ff, ffd, wfd)\n", optarg);
+        exit(1);
+      }
+      partitioned = 1;
+      break;
+    case 'n':
+      ncpus = atoi(optarg);
+      if (ncpus <= 0)
+      {
+        fprintf(stderr, "Bad number of CPUs '%s'\n", optarg);
+        exit(1);
+      }
+      break;
+    case 'c':
+      check_only = 1;
+      break;
+    case 'd':
+      if (locks_parse_policy(optarg, &on_deadlock) != 0)
+      {
+        fprintf(stderr, "Unknown deadlock policy '%s' (report, abort, recover)\n", optarg);
+        exit(1);
+      }
+      break;
+    case 's':
+      stats_file = optarg;
+      break;
+    default:
+      fprintf(stderr, "Usage: %s [-p pcp|srp|pip|none] [-o catchup|skip|abort] [-c] "
+                      "[-s stats-file] [-d report|abort|recover]\n"
+                      "       [-P ff|ffd|wfd] [-n cpus] [-S seconds|Nh [-v]] [-l probe-us]\n"
+                      "       [-w warm-up-secs] [-t trace-file] [-r seconds|Nh] [-E] [-D]\n"
+                      "       [-m shm-name] [-x seed] [taskset-file]\n",
+              argv[0]);
+      exit(1);
+    }
+  }
+  if (optind < argc)
+  {
+    taskset_file = argv[optind];
+  }
+
+  // SIGUSR1 is only accepted by the statistics dumper thread, SIGINT and
+  // SIGTERM by the run controller; the mask is inherited by every thread
+  // created from now on
+  sigemptyset(&sigset);
+  sigaddset(&sigset, SIGUSR1);
+  sigaddset(&sigset, SIGINT);
+  sigaddset(&sigset, SIGTERM);
+  pthread_sigmask(SIG_BLOCK, &sigset, NULL);
+  sigdelset(&sigset, SIGUSR1);
+  memset(&wake_action, 0, sizeof(wake_action));
+  wake_action.sa_handler = wake;
+  sigaction(WAKE_SIGNAL, &wake_action, NULL);
+
+  // Read the task set (periods, phases, execution times and resources)
+  if (taskset_load(taskset_file, &ts) != 0)
+  {
+    exit(1);
+  }
+
+  // Random execution times and faults repeat for a given seed
+  workload_seed(&ts, seed);
+
+  // A live run only has the CPUs of the process's affinity; the analysis
+  // and the simulator model as many as -n says
+  if (sim_length == NULL && !check_only && ncpus > partition_ncpus())
+  {
+    fprintf(stderr, "-n %d: the process may only run on %d CPUs\n", ncpus, partition_ncpus());
+    exit(1);
+  }
+
+  // Partitioned mode: assign every task to a CPU; resources shared by
+  // tasks of different CPUs become global (MPCP)
+  if (partitioned && partition_assign(&ts, heuristic, ncpus) != 0)
+  {
+    exit(1);
+  }
+  for (i = 0; i < ts.ntasks; i++)
+  {
+    pinned |= (ts.tasks[i].cpu >= 0);
+    if (sim_length == NULL && !check_only && ts.tasks[i].cpu >= partition_ncpus())
+    {
+      fprintf(stderr, "Task %d is pinned to CPU %d, but the process may only run on %d CPUs\n",
+              ts.tasks[i].id, ts.tasks[i].cpu, partition_ncpus());
+      exit(1);
+    }
+  }
+  if (use_srp && pinned)
+  {
+    fprintf(stderr, "The SRP locks need every task on the same CPU (no -P nor cpu=)\n");
+    exit(1);
+  }
+  nglobal = partition_mark_global(&ts);
+
+  // Rate-monotonic priorities for the tasks without an explicit one,
+  // always below the main program (max_prio-1) and, if there are global
+  // resources, below their ceiling. The ceilings follow from the
+  // priorities of the tasks that lock each resource; explicit priorities
+  // can still leave them out of range
+  taskset_assign_priorities(&ts, TASKSET_MAX_PRIO - (nglobal > 0));
+  if (taskset_check_ceilings(&ts, TASKSET_MAX_PRIO) != 0)
+  {
+    exit(1);
+  }
+  if (pinned)
+  {
+    partition_print(&ts, ncpus);
+  }
+
+  // Admission check: analytic response-time bounds for every protocol
+  if (analysis_run(&ts, &an) != 0)
+  {
+    printf("Error while analysing the task set\n");
+    exit(1);
+  }
+  analysis_print(&ts, &an, protocol);
+
+  // EDF: a SCHED_DEADLINE thread cannot be pinned to part of the CPUs nor
+  // use a priority ceiling; mutexes use inheritance, which the kernel
+  // extends to deadlines. The fixed-priority bounds above are only there
+  // for comparison
+  if (edf_mode)
+  {
+    if (pinned)
+    {
+      fprintf(stderr, "SCHED_DEADLINE threads cannot be pinned to CPUs (-P, cpu=)\n");
+      exit(1);
+    }
+    if (sim_length != NULL)
+    {
+      fprintf(stderr, "The simulator only supports fixed priorities\n");
+      exit(1);
+    }
+    if (dispatching)
+    {
+      fprintf(stderr, "The dispatcher only supports fixed priorities\n");
+      exit(1);
+    }
+    if (use_srp)
+    {
+      fprintf(stderr, "The SRP locks only support fixed priorities\n");
+      exit(1);
+    }
+    if (protocol == ANALYSIS_PCP)
+    {
+      protocol = ANALYSIS_PIP;
+    }
+    printf("SCHED_DEADLINE: density %.3f (%s), mutexes with %s\n", edf_density(&ts),
+           edf_density(&ts) <= 1.0 ? "schedulable without blocking" : "over 1",
+           protocol == ANALYSIS_PIP ? "inheritance" : "no protocol");
+    if (check_only)
+    {
+      exit(edf_density(&ts) <= 1.0 ? 0 : 2);
+    }
+  }
+  if (check_only)
+  {
+    exit(analysis_schedulable(&an, protocol) ? 0 : 2);
+  }
+  if (sim_length != NULL)
+  {
+    simulate(&ts, &an, protocol, sim_length, sim_trace);
+    exit(0);
+  }
+  // Keep every page in RAM from now on (stacks and buffers created later
+  // included), so that no job waits for a page fault
+  rt_lock_memory();
 
   // Set the priority of the main program to max_prio-1
   sch_param.sched_priority =
@@ -247,35 +701,99 @@ int main()
     exit(1);
   }
 
-  // Create the mutex attributes objects for R1 and R2
-  pthread_mutexattr_init(&mutexattr1);
-  pthread_mutexattr_init(&mutexattr2);
+  // Calibrate the busy wait at the main program's priority, so that it
+  // is not disturbed by other threads
+  eat_calibrate();
+  eat_report();
 
-  // Set the mutex protocol and ceiling for both mutexes
-  if (PROTOCOL == YES)
+  // Arenas of the memory and vector load kernels, timed alone as well
+  if (load_init(&ts) != 0)
+  {
+    printf("Error while allocating the load kernel arenas\n");
+    exit(1);
+  }
+
+  // Create the mutex attributes object shared by all the resources
+  pthread_mutexattr_init(&mutexattr);
+
+  // Set the mutex protocol for all the mutexes
+  if (protocol == ANALYSIS_PCP)
   {
     // With priority ceiling protocol, deadlock is avoided
-    pthread_mutexattr_setprotocol(&mutexattr1, PTHREAD_PRIO_PROTECT);
-    pthread_mutexattr_setprioceiling(&mutexattr1, sched_get_priority_min(SCHED_FIFO) + 5);
+    pthread_mutexattr_setprotocol(&mutexattr, PTHREAD_PRIO_PROTECT);
+  }
+  else if (protocol == ANALYSIS_PIP)
+  {
+    // Inheritance bounds priority inversion, but not deadlock
+    pthread_mutexattr_setprotocol(&mutexattr, PTHREAD_PRIO_INHERIT);
+  }
 
-    pthread_mutexattr_setprotocol(&mutexattr2, PTHREAD_PRIO_PROTECT);
-    pthread_mutexattr_setprioceiling(&mutexattr2, sched_get_priority_min(SCHED_FIFO) + 5);
+  // Live metrics: the task counters and the lock profiles go to the
+  // shared-memory segment instead of private memory
+  if (metrics_name != NULL)
+  {
+    if (metrics_open(metrics_name, &ts) != 0)
+    {
+      exit(1);
+    }
+    atexit(metrics_close);
   }
 
-  // Create mutex R1
-  if (pthread_mutex_init(&mutex1, &mutexattr1) != 0)
+  // SRP: the gate only orders the jobs of one CPU, so every thread
+  // created from now on inherits the CPU of the main program
+  if (use_srp)
   {
-    printf("mutex1_init (R1)\n");
-    exit(1);
+    cpu_set_t cpus;
+
+    CPU_ZERO(&cpus);
+    CPU_SET(sched_getcpu() >= 0 ? sched_getcpu() : 0, &cpus);
+    if (sched_setaffinity(0, sizeof(cpus), &cpus) != 0)
+    {
+      printf("Error while pinning to one CPU for the SRP locks\n");
+      exit(1);
+    }
+    if (srp_init(&ts, min_prio) != 0)
+    {
+      exit(1);
+    }
   }
 
-  // Create mutex R2
-  if (pthread_mutex_init(&mutex2, &mutexattr2) != 0)
+  // Owner and wait-for bookkeeping of the deadlock detector
+  if (locks_init(&ts, on_deadlock, use_srp) != 0)
   {
-    printf("mutex2_init (R2)\n");
+    printf("Error while initializing the lock layer\n");
     exit(1);
   }
 
+  // Create the mutexes R1..RM. The ceiling of a local resource is the
+  // highest priority of the tasks that lock it; a global one (MPCP) is one
+  // level above every task, so its critical sections are never preempted
+  // by the tasks of its CPU. The ceiling actually set is read back, since
+  // a wrong one either fails every lock or blocks needlessly
+  for (i = 0; i < ts.nresources; i++)
+  {
+    int ceiling = min_prio + ts.resources[i].ceiling, applied;
+
+    if (protocol == ANALYSIS_PCP &&
+        pthread_mutexattr_setprioceiling(&mutexattr, ceiling) != 0)
+    {
+      printf("Error while setting the ceiling %d of R%d\n", ceiling, ts.resources[i].id);
+      exit(1);
+    }
+    if (pthread_mutex_init(&ts.resources[i].mutex, &mutexattr) != 0)
+    {
+      printf("mutex_init (R%d)\n", ts.resources[i].id);
+      exit(1);
+    }
+    if (protocol == ANALYSIS_PCP &&
+        (pthread_mutex_getprioceiling(&ts.resources[i].mutex, &applied) != 0 ||
+         applied != ceiling))
+    {
+      printf("R%d: ceiling %d requested, %d applied\n", ts.resources[i].id, ceiling, applied);
+      exit(1);
+    }
+  }
+
   // Create the thread attributes object
   if (pthread_attr_init(&attr) != 0)
   {
@@ -293,13 +811,20 @@ int main()
     exit(1);
   }
 
-  // Thread is created dettached
-  if (pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED) != 0)
+  // Threads are joined by the run controller
+  if (pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE) != 0)
   {
     printf("Error in detachstate attribute\n");
     exit(1);
   }
 
+  // Explicit stack size, locked by mlockall and prefaulted by each thread
+  if (pthread_attr_setstacksize(&attr, RT_STACK_SIZE) != 0)
+  {
+    printf("Error in stacksize attribute\n");
+    exit(1);
+  }
+
   // The scheduling policy is fixed-priorities, with
   // FIFO ordering for threads of the same priority
   if (pthread_attr_setschedpolicy(&attr, SCHED_FIFO) != 0)
@@ -308,72 +833,155 @@ int main()
     exit(1);
   }
 
-  // Capture initial time before creating the threads so timestamps start near 0
+  // Common first release, a little ahead so that every thread is ready
+  // by then; timestamps are relative to it. The run ends a whole number
+  // of seconds or hyperperiods later
   clock_gettime(CLOCK_MONOTONIC, &initial_time);
-
-  // Set the priority of thread 1 to min_prio+5
-  sch_param.sched_priority =
-      (sched_get_priority_min(SCHED_FIFO) + 5);
-  if (pthread_attr_setschedparam(&attr, &sch_param) != 0)
+  initial_time.tv_nsec += START_DELAY_NS;
+  initial_time.tv_sec += initial_time.tv_nsec / 1000000000;
+  initial_time.tv_nsec %= 1000000000;
+  add_timespec(&warmup_end, &initial_time, &warmup);
+  if (run_length != NULL)
   {
-    printf("Error en atributo schedparam\n");
-    exit(1);
-  }
+    struct timespec length;
+    int64_t n = parse_length(run_length, taskset_hyperperiod(&ts));
 
-  // create thread 1 with the attributes specified in attr_used
+    length.tv_sec = n / 1000000000;
+    length.tv_nsec = n % 1000000000;
+    add_timespec(&run_end, &initial_time, &length);
+    bounded_run = 1;
+  }
 
-  if (pthread_create(&t1, &attr, periodic, &data1) != 0)
+  // Dispatcher: the workers of each priority level and the timer thread
+  // replace the periodic threads
+  nthreads = ts.ntasks;
+  if (dispatching)
   {
-    printf("Error en creacion de thread 1\n");
+    dispatch.start = initial_time;
+    dispatch.end = run_end;
+    dispatch.bounded = bounded_run;
+    dispatch.measure = warmup_end;
+    dispatch.overrun = on_overrun;
+    dispatch.min_prio = min_prio;
+    dispatch.job = run_job;
+    dispatch.barrier = &start_barrier;
+    dispatch.stopping = &stopping;
+    if ((nthreads = dispatch_init(&ts, &dispatch)) < 0)
+    {
+      printf("Error while initializing the dispatcher\n");
+      exit(1);
+    }
+    dispatch_print(stdout);
   }
+  threads = calloc(nthreads, sizeof(pthread_t));
+  pthread_barrier_init(&start_barrier, NULL, nthreads + 1);
 
-  // Set the priority of thread 2 to min_prio+4
-  sch_param.sched_priority =
-      (sched_get_priority_min(SCHED_FIFO) + 4);
-  if (pthread_attr_setschedparam(&attr, &sch_param) != 0)
+  // One trace ring per periodic thread, drained at the lowest priority
+  // so that formatting never competes with the periodic threads
+  if (trace_init(ts.ntasks, &initial_time) != 0)
   {
-    printf("Error en atributo schedparam\n");
+    printf("Error while allocating trace buffers\n");
     exit(1);
   }
-
-  // create thread 2 with the attributes specified in attr_used
-
-  if (pthread_create(&t2, &attr, periodic, &data2) != 0)
+  for (i = 0; i < ts.ntasks; i++)
   {
-    printf("Error en creacion de thread 2\n");
+    ts.tasks[i].trace = trace_ring(i);
+    rt_prefault(ts.tasks[i].trace->events, TRACE_RING_CAPACITY * sizeof(struct trace_event));
   }
-
-  // Set the priority of thread 3 to min_prio+3
-  sch_param.sched_priority =
-      (sched_get_priority_min(SCHED_FIFO) + 3);
-  if (pthread_attr_setschedparam(&attr, &sch_param) != 0)
+  if (trace_file != NULL && trace_open_file(trace_file) != 0)
   {
-    printf("Error en atributo schedparam\n");
+    exit(1);
+  }
+  if (trace_start_drainer(min_prio) != 0)
+  {
+    printf("Error while creating trace drainer thread\n");
     exit(1);
   }
 
-  // create thread 3 with the attributes specified in attr_used
+  // Response-time and release-jitter histograms, dumped on SIGUSR1
+  if ((stats = stats_alloc(ts.ntasks)) == NULL)
+  {
+    printf("Error while allocating statistics\n");
+    exit(1);
+  }
+  rt_prefault(stats, ts.ntasks * sizeof(struct task_stats));
+  for (i = 0; i < ts.ntasks; i++)
+  {
+    ts.tasks[i].stats = &stats[i];
+  }
+  if (stats_start_dumper(&ts, stats_file, min_prio) != 0)
+  {
+    printf("Error while creating statistics thread\n");
+    exit(1);
+  }
 
-  if (pthread_create(&t3, &attr, periodic, &data3) != 0)
+  // Latency probe above everything else, main program included, so that
+  // its wake-ups only wait for the kernel
+  if (probe_interval > 0 && stats_start_probe(probe_interval, max_prio) != 0)
   {
-    printf("Error en creacion de thread 3\n");
+    printf("Error while creating latency probe thread\n");
+    exit(1);
   }
 
-  // Set the priority of thread 4 to min_prio+2
-  sch_param.sched_priority =
-      (sched_get_priority_min(SCHED_FIFO) + 2);
-  if (pthread_attr_setschedparam(&attr, &sch_param) != 0)
+  if (dispatching && dispatch_start(&attr, threads) != 0)
   {
-    printf("Error en atributo schedparam\n");
+    printf("Error while creating the dispatcher threads\n");
     exit(1);
   }
+  for (i = 0; i < ts.ntasks && !dispatching; i++)
+  {
+    struct periodic_data *d = &ts.tasks[i];
 
-  // create thread 4 with the attributes specified in attr_used
+    // Set the priority of the thread to min_prio + its task priority
+    sch_param.sched_priority = min_prio + d->prio;
+    if (pthread_attr_setschedparam(&attr, &sch_param) != 0)
+    {
+      printf("Error en atributo schedparam\n");
+      exit(1);
+    }
 
-  if (pthread_create(&t4, &attr, periodic, &data4) != 0)
-  {
-    printf("Error en creacion de thread 4\n");
+    // Pin the thread to its CPU in partitioned mode
+    if (pinned && partition_set_affinity(&attr, d->cpu) != 0)
+    {
+      printf("Error in affinity attribute\n");
+      exit(1);
+    }
+
+    // create the thread with the attributes specified in attr
+    if (pthread_create(&threads[i], &attr, periodic, d) != 0)
+    {
+      printf("Error en creacion de thread %d\n", d->id);
+      exit(1);
+    }
   }
 
-  sleep(1000);
+  stuck = run(&ts, nthreads, threads, &sigset);
+
+  // Consolidated results: per-task summary, measured worst-case response
+  // times next to the analytic bounds, and the final statistics
+  trace_flush();
+  stats_print_summary(stdout, &ts);
+  workload_print_faults(stdout, &ts);
+  if (!edf_mode)
+  {
+    analysis_print_measured(&ts, &an, protocol);
+  }
+  eat_report();
+  load_report(stdout, &ts);
+  if (stats_file != NULL && (stats_out = fopen(stats_file, "w")) == NULL)
+  {
+    perror(stats_file);
+  }
+  stats_dump(stats_out != NULL ? stats_out : stdout, &ts);
+  if (stats_out != NULL)
+  {
+    fclose(stats_out);
+  }
+  stats_print_latency(stdout, &ts);
+  locks_print_profile(stdout, &ts);
+  if (use_srp)
+  {
+    srp_report(stdout);
+  }
+  return stuck > 0 ? 3 : 0;
 }
@@ -0,0 +1,384 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include "taskset.h"
+#include "analysis.h"
+#include "sim.h"
+#include "workload.h"
+
+/**
+ * Critical-instant search. The worst response time of a task depends on
+ * the relative release phases; the task-set file only fixes one of them.
+ * This program simulates the set (in virtual time, so periods need no
+ * scaling) under many phasings and reports, for every task, the largest
+ * response time found and the phases that produce it, next to the
+ * analytic bound, plus the phasings that end in a deadlock.
+ *
+ * The grid mode tries every combination of g phases per task in [0, T)
+ * (the lowest-priority task stays at 0, only relative phases matter). The
+ * search mode starts from the phases of the file, all zeros and, for
+ * every task and every critical section of a lower-priority task that can
+ * block it, the textbook critical instant: the blocker locks just before
+ * the task and every other task is released with it. It then keeps the
+ * worst phasing of every task and perturbs it one phase at a time, with
+ * steps that shrink as the search goes on, and with some random restarts.
+ **/
+
+struct sweep
+{
+  struct task_set ts;
+  struct analysis an;
+  struct sim_config cfg;
+  double length;      // simulated time after the last first release, in longest periods
+  int64_t longest;    // longest period, ns
+  int n;
+  int64_t *period;    // ns, per task
+  int64_t **worst;    // worst[i]: phases that gave the worst response of task i
+  int64_t *wcrt;      // worst response time found per task
+  int64_t configs;    // phasings simulated
+  int64_t deadlocks;  // phasings that ended in a deadlock
+  int64_t *deadlock;  // first of them
+  const char *dir;    // where to write the worst phasings, NULL if not written
+};
+
+static uint64_t rng_state = 1; // workload.h generator
+
+static inline int64_t ns(const struct timespec *t)
+{
+  return (int64_t)t->tv_sec * 1000000000 + t->tv_nsec;
+}
+
+// Phase in [0, T)
+static int64_t wrap(int64_t phase, int64_t period)
+{
+  phase %= period;
+  return phase < 0 ? phase + period : phase;
+}
+
+// Simulate one phasing and keep it wherever it is the worst so far.
+// Returns 1 if it improved the response time of task target (any task if
+// target < 0)
+static int evaluate(struct sweep *w, const int64_t *phase, int target)
+{
+  struct sim_result r;
+  int64_t last = 0;
+  int i, improved = 0;
+
+  for (i = 0; i < w->n; i++)
+  {
+    w->ts.tasks[i].phase.tv_sec = phase[i] / 1000000000;
+    w->ts.tasks[i].phase.tv_nsec = phase[i] % 1000000000;
+    if (phase[i] > last)
+      last = phase[i];
+  }
+  w->cfg.duration = last + (int64_t)(w->length * w->longest);
+  if (sim_run(&w->ts, &w->cfg, &r) != 0)
+  {
+    printf("Error while simulating the task set\n");
+    exit(1);
+  }
+  w->configs++;
+  if (r.deadlock && w->deadlocks++ == 0)
+    memcpy(w->deadlock, phase, w->n * sizeof(int64_t));
+  for (i = 0; i < w->n; i++)
+  {
+    if (r.tasks[i].wcrt > w->wcrt[i])
+    {
+      w->wcrt[i] = r.tasks[i].wcrt;
+      memcpy(w->worst[i], phase, w->n * sizeof(int64_t));
+      improved |= (target < 0 || target == i);
+    }
+  }
+  sim_free(&r);
+  return improved;
+}
+
+// Index of the lowest-priority task (its phase is the reference in grid mode)
+static int lowest(const struct sweep *w)
+{
+  int i, low = 0;
+
+  for (i = 1; i < w->n; i++)
+  {
+    if (w->ts.tasks[i].prio < w->ts.tasks[low].prio)
+      low = i;
+  }
+  return low;
+}
+
+static void grid(struct sweep *w, int steps)
+{
+  int64_t phase[w->n];
+  int index[w->n];
+  int ref = lowest(w), i;
+  double total = 1.0;
+
+  for (i = 0; i < w->n - 1; i++)
+    total *= steps;
+  if (total > 1.0e6)
+  {
+    fprintf(stderr, "%.0f phasings are too many for a grid, use -s\n", total);
+    exit(1);
+  }
+  memset(index, 0, sizeof(index));
+  while (1)
+  {
+    for (i = 0; i < w->n; i++)
+      phase[i] = i == ref ? 0 : w->period[i] * index[i] / steps;
+    evaluate(w, phase, -1);
+
+    // Next combination, as an odometer skipping the reference task
+    for (i = 0; i < w->n; i++)
+    {
+      if (i == ref)
+        continue;
+      if (++index[i] < steps)
+        break;
+      index[i] = 0;
+    }
+    if (i == w->n)
+      break;
+  }
+}
+
+// Time from the release of d to the start of its segment k, if it runs alone
+static int64_t offset_of(const struct periodic_data *d, int k)
+{
+  int64_t t = 0;
+  int s;
+
+  for (s = 0; s < k; s++)
+  {
+    if (d->segments[s].kind == SEGMENT_COMPUTE)
+      t += ns(&d->segments[s].time);
+  }
+  return t;
+}
+
+// Critical instants: for task i and every lock of a lower-priority task k
+// on a resource some task of priority >= prio(i) uses (i can be blocked
+// on it, directly or by inheritance), k is released first so that it
+// takes the lock 1 us before everybody else is released
+static void critical_instants(struct sweep *w)
+{
+  int64_t phase[w->n];
+  int i, j, k, s;
+
+  for (i = 0; i < w->n; i++)
+  {
+    const struct periodic_data *ti = &w->ts.tasks[i];
+
+    for (k = 0; k < w->n; k++)
+    {
+      const struct periodic_data *tk = &w->ts.tasks[k];
+
+      if (tk->prio >= ti->prio)
+        continue;
+      for (s = 0; s < tk->nsegments; s++)
+      {
+        int64_t release;
+
+        if (tk->segments[s].kind != SEGMENT_LOCK || tk->segments[s].res->ceiling < ti->prio)
+          continue;
+        release = offset_of(tk, s) + 1000;
+        for (j = 0; j < w->n; j++)
+          phase[j] = j == k ? 0 : release;
+        evaluate(w, phase, -1);
+      }
+    }
+  }
+}
+
+static void search(struct sweep *w, int iterations)
+{
+  int64_t phase[w->n];
+  int it, i, j;
+
+  // Seeds: the file's phases, all zeros and the critical instants
+  for (i = 0; i < w->n; i++)
+    phase[i] = wrap(ns(&w->ts.tasks[i].phase), w->period[i]);
+  evaluate(w, phase, -1);
+  memset(phase, 0, sizeof(phase));
+  evaluate(w, phase, -1);
+  critical_instants(w);
+
+  for (it = 0; it < iterations; it++)
+  {
+    int target = it % w->n;
+    double scale = 0.5 * (1.0 - (double)it / iterations) + 0.001;
+
+    if (workload_uniform(&rng_state) < 0.1)
+    {
+      // Random restart
+      for (j = 0; j < w->n; j++)
+        phase[j] = (int64_t)(workload_uniform(&rng_state) * w->period[j]);
+      evaluate(w, phase, -1);
+      continue;
+    }
+    // Move one phase of the worst phasing of target
+    memcpy(phase, w->worst[target], sizeof(phase));
+    j = (int)(workload_uniform(&rng_state) * w->n);
+    phase[j] = wrap(phase[j] + (int64_t)((2.0 * workload_uniform(&rng_state) - 1.0) * scale * w->period[j]),
+                    w->period[j]);
+    evaluate(w, phase, target);
+  }
+}
+
+static void print_phases(FILE *f, const struct sweep *w, const int64_t *phase)
+{
+  int i;
+
+  for (i = 0; i < w->n; i++)
+    fprintf(f, " %d=%.6f", w->ts.tasks[i].id, phase[i] / 1.0e9);
+  fprintf(f, "\n");
+}
+
+// Write the task set with the phases of a worst case
+static void write_set(struct sweep *w, const char *name, const int64_t *phase)
+{
+  char path[4096];
+  FILE *f;
+  int i;
+
+  snprintf(path, sizeof(path), "%s/%s.cfg", w->dir, name);
+  if ((f = fopen(path, "w")) == NULL)
+  {
+    perror(path);
+    exit(1);
+  }
+  for (i = 0; i < w->n; i++)
+  {
+    w->ts.tasks[i].phase.tv_sec = phase[i] / 1000000000;
+    w->ts.tasks[i].phase.tv_nsec = phase[i] % 1000000000;
+  }
+  fprintf(f, "# %s, found by phasesweep\n", name);
+  taskset_write(f, &w->ts);
+  fclose(f);
+}
+
+static void usage(const char *name)
+{
+  fprintf(stderr, "Usage: %s [-p pcp|pip|none] [-o catchup|skip|abort] [-g steps | -s iterations]\n"
+                  "       [-L periods] [-x seed] [-w dir] [taskset-file]\n",
+          name);
+  exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+  struct sweep w;
+  const char *path = "tasks.cfg";
+  int steps = 0, iterations = 2000, opt, i;
+
+  memset(&w, 0, sizeof(w));
+  w.cfg.protocol = ANALYSIS_PCP;
+  w.cfg.overrun = OVERRUN_CATCH_UP;
+  w.length = 2.0;
+  while ((opt = getopt(argc, argv, "p:o:g:s:L:x:w:")) != -1)
+  {
+    switch (opt)
+    {
+    case 'p':
+      if (analysis_parse_protocol(optarg, &w.cfg.protocol) != 0)
+        usage(argv[0]);
+      break;
+    case 'o':
+      if (taskset_parse_overrun(optarg, &w.cfg.overrun) != 0)
+        usage(argv[0]);
+      break;
+    case 'g':
+      steps = atoi(optarg);
+      if (steps <= 0)
+        usage(argv[0]);
+      break;
+    case 's':
+      iterations = atoi(optarg);
+      if (iterations < 0)
+        usage(argv[0]);
+      break;
+    case 'L':
+      w.length = atof(optarg);
+      if (w.length <= 0)
+        usage(argv[0]);
+      break;
+    case 'x':
+      rng_state = strtoull(optarg, NULL, 0);
+      break;
+    case 'w':
+      w.dir = optarg;
+      break;
+    default:
+      usage(argv[0]);
+    }
+  }
+  if (optind < argc)
+    path = argv[optind];
+
+  if (taskset_load(path, &w.ts) != 0)
+    exit(1);
+  taskset_assign_priorities(&w.ts, TASKSET_MAX_PRIO);
+  if (analysis_run(&w.ts, &w.an) != 0)
+  {
+    printf("Error while analysing the task set\n");
+    exit(1);
+  }
+  w.n = w.ts.ntasks;
+  w.period = calloc(w.n, sizeof(int64_t));
+  w.wcrt = calloc(w.n, sizeof(int64_t));
+  w.worst = calloc(w.n, sizeof(int64_t *));
+  w.deadlock = calloc(w.n, sizeof(int64_t));
+  if (w.period == NULL || w.wcrt == NULL || w.worst == NULL || w.deadlock == NULL)
+  {
+    printf("Out of memory\n");
+    exit(1);
+  }
+  for (i = 0; i < w.n; i++)
+  {
+    w.period[i] = ns(&w.ts.tasks[i].period);
+    if (w.period[i] > w.longest)
+      w.longest = w.period[i];
+    w.wcrt[i] = -1;
+    if ((w.worst[i] = calloc(w.n, sizeof(int64_t))) == NULL)
+    {
+      printf("Out of memory\n");
+      exit(1);
+    }
+  }
+
+  if (steps > 0)
+    grid(&w, steps);
+  else
+    search(&w, iterations);
+
+  printf("Phase sweep (%s, %s): %lld phasings of %.1f longest periods each\n",
+         steps > 0 ? "grid" : "search", analysis_protocol_name(w.cfg.protocol),
+         (long long)w.configs, w.length);
+  printf("  Task     WCRT    Bound | phases of the worst case (s)\n");
+  for (i = 0; i < w.n; i++)
+  {
+    int64_t bound = w.an.tasks[i].wcrt[w.cfg.protocol];
+    char name[64];
+
+    printf("  %4d %8.3f ", w.ts.tasks[i].id, w.wcrt[i] / 1.0e9);
+    if (bound == ANALYSIS_UNBOUNDED)
+      printf("%8s |", "inf");
+    else
+      printf("%8.3f%s|", bound / 1.0e9, w.wcrt[i] > bound ? "!" : " ");
+    print_phases(stdout, &w, w.worst[i]);
+    if (w.dir != NULL)
+    {
+      snprintf(name, sizeof(name), "worst_task%d", w.ts.tasks[i].id);
+      write_set(&w, name, w.worst[i]);
+    }
+  }
+  if (w.deadlocks > 0)
+  {
+    printf("Deadlock in %lld phasings, first:", (long long)w.deadlocks);
+    print_phases(stdout, &w, w.deadlock);
+    if (w.dir != NULL)
+      write_set(&w, "deadlock", w.deadlock);
+  }
+  return 0;
+}
@@ -0,0 +1,484 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "timespec_operations.h"
+#include "taskset.h"
+#include "analysis.h"
+#include "sim.h"
+#include "workload.h"
+
+/**
+ * Protocol comparison benchmark. Generates random task sets (UUniFast
+ * utilizations, log-uniform periods, critical sections on randomly shared
+ * resources), simulates every set under no protocol, priority inheritance
+ * and the priority ceiling protocol, and writes one CSV line per set,
+ * protocol and task to stdout. A summary per utilization goes to stderr.
+ * With -w every set is also written as a task-set file, so that it can be
+ * run live with periodic_sr -p none|pip|pcp. With -R every set is also run
+ * live by periodic_sr under each protocol, with its times scaled by -k,
+ * and the measured results go to the same CSV (mode "live" instead of
+ * "sim").
+ **/
+
+struct bench_config
+{
+  int ntasks;        // tasks per set
+  double u_min, u_max, u_step;
+  int nsets;         // sets per utilization
+  int nresources;
+  double share;      // probability that a task uses each resource
+  double cs;         // length of each critical section, as a fraction of C
+  double t_min, t_max; // period range, in seconds
+  int nested;        // nest the critical sections in random order
+  double length;     // simulated time, in longest periods
+  overrun_policy overrun;
+  const char *overrun_name; // as given to -o, passed on to periodic_sr
+  const char *dir;   // where to write the sets, NULL if not written
+  const char *live;  // periodic_sr to run the sets live, NULL if only simulated
+  double scale;      // factor applied to every time of a live set
+};
+
+// Mode column of the CSV: simulated or run live
+static const char *mode_names[2] = {"sim", "live"};
+
+static uint64_t rng_state; // workload.h generator
+
+// UUniFast: n utilizations uniformly distributed with sum u
+static void uunifast(int n, double u, double *util)
+{
+  double sum = u;
+  int i;
+
+  for (i = 0; i < n - 1; i++)
+  {
+    double next = sum * pow(workload_uniform(&rng_state), 1.0 / (n - i - 1));
+
+    util[i] = sum - next;
+    sum = next;
+  }
+  util[n - 1] = sum;
+}
+
+// Write one random task set with total utilization u in the task-set file
+// format
+static void generate(FILE *f, const struct bench_config *b, double u)
+{
+  double util[b->ntasks];
+  int order[b->nresources > 0 ? b->nresources : 1];
+  int i, k;
+
+  uunifast(b->ntasks, u, util);
+  fprintf(f, "# UUniFast task set, U = %.3f\n", u);
+  if (b->nresources > 0)
+    fprintf(f, "resources %d\n", b->nresources);
+  for (i = 0; i < b->ntasks; i++)
+  {
+    double period = b->t_min * pow(b->t_max / b->t_min, workload_uniform(&rng_state));
+    double c, cs, piece;
+    int used = 0;
+
+    period = ceil(period * 1000.0) / 1000.0;
+    c = floor(util[i] * period * 1.0e6) / 1.0e6;
+    if (c < 1.0e-6)
+      c = 1.0e-6;
+
+    for (k = 0; k < b->nresources; k++)
+    {
+      if (workload_uniform(&rng_state) < b->share)
+        order[used++] = k;
+    }
+    for (k = used - 1; k > 0; k--)
+    {
+      int r = (int)(workload_uniform(&rng_state) * (k + 1)), t = order[k];
+
+      order[k] = order[r];
+      order[r] = t;
+    }
+
+    // Critical sections of cs*C each, the rest of C split around them
+    cs = b->cs * c;
+    if (cs * used >= c)
+      cs = c / (used + 1);
+    piece = (c - cs * used) / (used + 1);
+
+    fprintf(f, "task id=%d period=%.3f phase=0 body=C:%.9f", i + 1, period, piece);
+    for (k = 0; k < used; k++)
+    {
+      fprintf(f, ",L:R%d,C:%.9f", order[k] + 1, cs);
+      if (!b->nested)
+        fprintf(f, ",U:R%d,C:%.9f", order[k] + 1, piece);
+    }
+    for (k = used - 1; b->nested && k >= 0; k--)
+      fprintf(f, ",U:R%d", order[k] + 1);
+    if (b->nested && used > 0)
+      fprintf(f, ",C:%.9f", piece * used);
+    fprintf(f, "\n");
+  }
+}
+
+// Parse "a" or "a:b" or "a:b:c" into up to three doubles
+static int parse_range(const char *s, double *v, int n)
+{
+  char *end;
+  int i;
+
+  for (i = 0; i < n; i++)
+  {
+    v[i] = strtod(s, &end);
+    if (end == s)
+      return -1;
+    if (*end == '\0')
+      return i + 1;
+    if (*end != ':')
+      return -1;
+    s = end + 1;
+  }
+  return -1;
+}
+
+// Multiply every time of ts by k (the generated sets have no execution
+// time distributions)
+static void scale_set(struct task_set *ts, double k)
+{
+  int i, j;
+
+  for (i = 0; i < ts->ntasks; i++)
+  {
+    struct periodic_data *d = &ts->tasks[i];
+
+    d->period = d2t(t2d(d->period) * k);
+    d->deadline = d2t(t2d(d->deadline) * k);
+    d->phase = d2t(t2d(d->phase) * k);
+    for (j = 0; j < d->nsegments; j++)
+    {
+      if (d->segments[j].kind == SEGMENT_COMPUTE)
+        d->segments[j].time = d2t(t2d(d->segments[j].time) * k);
+    }
+  }
+}
+
+// Read the statistics written by periodic_sr -s into r: jobs and worst
+// response, misses, skipped and aborted jobs and the longest lock wait of
+// every task. Returns -1 if the file cannot be read
+static int read_stats(const char *path, const struct task_set *ts, struct sim_result *r)
+{
+  FILE *f = fopen(path, "r");
+  char line[256], metric[64];
+  unsigned long long n, max;
+  int id, i;
+
+  if (f == NULL || fgets(line, sizeof(line), f) == NULL)
+  {
+    if (f != NULL)
+      fclose(f);
+    return -1;
+  }
+  while (fgets(line, sizeof(line), f) != NULL)
+  {
+    if (sscanf(line, "%d,%63[^,],%llu,%*u,%*u,%*u,%*u,%*u,%llu", &id, metric, &n, &max) != 4)
+      continue;
+    for (i = 0; i < ts->ntasks && ts->tasks[i].id != id; i++)
+      ;
+    if (i == ts->ntasks)
+      continue;
+    if (strcmp(metric, "response") == 0)
+    {
+      r->tasks[i].jobs = (int64_t)n;
+      r->tasks[i].wcrt = (int64_t)max;
+    }
+    else if (strcmp(metric, "lateness") == 0)
+      r->tasks[i].misses = (int64_t)n;
+    else if (strcmp(metric, "skipped") == 0)
+      r->tasks[i].skipped = (int64_t)n;
+    else if (strcmp(metric, "aborted") == 0)
+      r->tasks[i].aborted = (int64_t)n;
+    else if (strncmp(metric, "lock_wait_", 10) == 0 && (int64_t)max > r->tasks[i].max_blocking)
+      r->tasks[i].max_blocking = (int64_t)max;
+  }
+  fclose(f);
+  return 0;
+}
+
+// Run the task-set file cfg with periodic_sr for length nanoseconds under
+// protocol p and read what it measured into r. A run that ends with tasks
+// stuck in a deadlock (exit status 3) sets r->deadlock
+static void live_run(const struct bench_config *b, const char *cfg, const char *stats,
+                     const struct task_set *ts, analysis_protocol p, int64_t length,
+                     struct sim_result *r)
+{
+  char cmd[8192];
+  int status;
+
+  snprintf(cmd, sizeof(cmd), "'%s' -p %s -o %s -r %.9f -s '%s' '%s' > /dev/null 2>&1",
+           b->live, analysis_protocol_name(p), b->overrun_name, length / 1.0e9, stats, cfg);
+  remove(stats);
+  status = system(cmd);
+  if (status == -1 || !WIFEXITED(status) ||
+      (WEXITSTATUS(status) != 0 && WEXITSTATUS(status) != 3))
+  {
+    fprintf(stderr, "Live run failed: %s\n", cmd);
+    exit(1);
+  }
+  memset(r, 0, sizeof(*r));
+  r->ntasks = ts->ntasks;
+  r->tasks = calloc(ts->ntasks, sizeof(struct sim_task_result));
+  r->deadlock = WEXITSTATUS(status) == 3;
+  if (r->tasks == NULL || read_stats(stats, ts, r) != 0)
+  {
+    fprintf(stderr, "Cannot read the statistics of the live run: %s\n", cmd);
+    exit(1);
+  }
+}
+
+static void usage(const char *name)
+{
+  fprintf(stderr, "Usage: %s [-n tasks] [-u u | umin:umax:step] [-m sets] [-r resources]\n"
+                  "       [-s share] [-l cs] [-T tmin:tmax] [-N] [-L periods]\n"
+                  "       [-o catchup|skip|abort] [-x seed] [-w dir] [-R periodic_sr [-k scale]]\n",
+          name);
+  exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+  struct bench_config b = {5, 0.3, 0.9, 0.1, 100, 2, 0.5, 0.1, 0.01, 1.0, 0, 20.0,
+                            OVERRUN_CATCH_UP, "catchup", NULL, NULL, 1.0};
+  char tmp[] = "/tmp/protobenchXXXXXX", cfg[64], stats[64];
+  double v[3];
+  int set = 0, opt, n, p, i, live;
+  double u;
+
+  rng_state = 1;
+  while ((opt = getopt(argc, argv, "n:u:m:r:s:l:T:NL:o:x:w:R:k:")) != -1)
+  {
+    switch (opt)
+    {
+    case 'n':
+      b.ntasks = atoi(optarg);
+      break;
+    case 'u':
+      n = parse_range(optarg, v, 3);
+      if (n == 1)
+      {
+        b.u_min = b.u_max = v[0];
+        b.u_step = 1.0;
+      }
+      else if (n == 3 && v[2] > 0)
+      {
+        b.u_min = v[0];
+        b.u_max = v[1];
+        b.u_step = v[2];
+      }
+      else
+      {
+        usage(argv[0]);
+      }
+      break;
+    case 'm':
+      b.nsets = atoi(optarg);
+      break;
+    case 'r':
+      b.nresources = atoi(optarg);
+      break;
+    case 's':
+      b.share = atof(optarg);
+      break;
+    case 'l':
+      b.cs = atof(optarg);
+      break;
+    case 'T':
+      if (parse_range(optarg, v, 2) != 2 || v[0] <= 0 || v[1] < v[0])
+        usage(argv[0]);
+      b.t_min = v[0];
+      b.t_max = v[1];
+      break;
+    case 'N':
+      b.nested = 1;
+      break;
+    case 'L':
+      b.length = atof(optarg);
+      break;
+    case 'o':
+      if (taskset_parse_overrun(optarg, &b.overrun) != 0)
+        usage(argv[0]);
+      b.overrun_name = optarg;
+      break;
+    case 'x':
+      rng_state = strtoull(optarg, NULL, 0);
+      break;
+    case 'w':
+      b.dir = optarg;
+      break;
+    case 'R':
+      b.live = optarg;
+      break;
+    case 'k':
+      b.scale = atof(optarg);
+      break;
+    default:
+      usage(argv[0]);
+    }
+  }
+  if (b.ntasks <= 0 || b.nsets <= 0 || b.nresources < 0 || b.length <= 0 || b.scale <= 0)
+    usage(argv[0]);
+
+  // The live sets and their statistics go to a private directory
+  if (b.live != NULL)
+  {
+    if (mkdtemp(tmp) == NULL)
+    {
+      perror(tmp);
+      exit(1);
+    }
+    snprintf(cfg, sizeof(cfg), "%s/set.cfg", tmp);
+    snprintf(stats, sizeof(stats), "%s/stats.csv", tmp);
+  }
+
+  printf("set,utilization,protocol,task,prio,period_ns,wcet_ns,jobs,misses,"
+         "skipped,aborted,wcrt_ns,bound_ns,max_lock_wait_ns,deadlock,mode\n");
+  fprintf(stderr, "   U protocol mode  sets  no-miss  deadlock  analysis\n");
+
+  for (u = b.u_min; u <= b.u_max + 1e-9; u += b.u_step)
+  {
+    int ok[2][ANALYSIS_PROTOCOLS] = {{0}}, dead[2][ANALYSIS_PROTOCOLS] = {{0}};
+    int bounded[ANALYSIS_PROTOCOLS] = {0};
+    int s;
+
+    for (s = 0; s < b.nsets; s++, set++)
+    {
+      struct task_set ts, scaled;
+      struct analysis an;
+      char *text;
+      size_t size;
+      FILE *f = open_memstream(&text, &size);
+      int64_t longest = 0;
+
+      generate(f, &b, u);
+      fclose(f);
+      if (b.dir != NULL)
+      {
+        char path[4096];
+
+        snprintf(path, sizeof(path), "%s/set%04d.cfg", b.dir, set);
+        if ((f = fopen(path, "w")) == NULL)
+        {
+          perror(path);
+          exit(1);
+        }
+        fputs(text, f);
+        fclose(f);
+      }
+
+      f = fmemopen(text, size, "r");
+      if (taskset_read(f, "generated", &ts) != 0)
+      {
+        fprintf(stderr, "Generated task set %d:\n%s", set, text);
+        exit(1);
+      }
+      fclose(f);
+      taskset_assign_priorities(&ts, TASKSET_MAX_PRIO);
+
+      // The live copy has the same priorities, explicit in its file
+      if (b.live != NULL)
+      {
+        f = fmemopen(text, size, "r");
+        taskset_read(f, "generated", &scaled);
+        fclose(f);
+        scale_set(&scaled, b.scale);
+        for (i = 0; i < ts.ntasks; i++)
+          scaled.tasks[i].prio = ts.tasks[i].prio;
+        taskset_compute_ceilings(&scaled);
+        if ((f = fopen(cfg, "w")) == NULL)
+        {
+          perror(cfg);
+          exit(1);
+        }
+        taskset_write(f, &scaled);
+        fclose(f);
+      }
+      free(text);
+      if (analysis_run(&ts, &an) != 0)
+      {
+        printf("Error while analysing the task set\n");
+        exit(1);
+      }
+      for (i = 0; i < ts.ntasks; i++)
+      {
+        int64_t t = (int64_t)ts.tasks[i].period.tv_sec * 1000000000 + ts.tasks[i].period.tv_nsec;
+
+        if (t > longest)
+          longest = t;
+      }
+
+      // Simulated, and then live with every time (and the bounds) scaled
+      for (p = 0; p < ANALYSIS_PROTOCOLS; p++)
+      {
+        for (live = 0; live <= (b.live != NULL); live++)
+        {
+          struct sim_config sim = {(analysis_protocol)p, (int64_t)(b.length * longest), 0,
+                                   b.overrun};
+          const struct task_set *run = live ? &scaled : &ts;
+          double k = live ? b.scale : 1.0;
+          struct sim_result r;
+          int misses = 0;
+
+          if (live)
+          {
+            live_run(&b, cfg, stats, &scaled, (analysis_protocol)p,
+                     (int64_t)(b.length * longest * k), &r);
+          }
+          else if (sim_run(&ts, &sim, &r) != 0)
+          {
+            printf("Error while simulating the task set\n");
+            exit(1);
+          }
+          for (i = 0; i < ts.ntasks; i++)
+          {
+            const struct periodic_data *d = &run->tasks[i];
+            const struct sim_task_result *t = &r.tasks[i];
+            int64_t bound = an.tasks[i].wcrt[p];
+
+            printf("%d,%.3f,%s,%d,%d,%lld,%lld,%lld,%lld,%lld,%lld,%lld,%lld,%lld,%d,%s\n", set,
+                   u, analysis_protocol_name((analysis_protocol)p), d->id, d->prio,
+                   (long long)d->period.tv_sec * 1000000000 + d->period.tv_nsec,
+                   (long long)(an.tasks[i].wcet * k), (long long)t->jobs, (long long)t->misses,
+                   (long long)t->skipped, (long long)t->aborted, (long long)t->wcrt,
+                   (long long)(bound == ANALYSIS_UNBOUNDED ? -1 : bound * k),
+                   (long long)t->max_blocking, r.deadlock, mode_names[live]);
+            misses += t->misses > 0;
+          }
+          ok[live][p] += (misses == 0 && !r.deadlock);
+          dead[live][p] += r.deadlock;
+          sim_free(&r);
+        }
+        bounded[p] += analysis_schedulable(&an, (analysis_protocol)p);
+      }
+      analysis_free(&an);
+      taskset_free(&ts);
+      if (b.live != NULL)
+        taskset_free(&scaled);
+    }
+
+    for (p = 0; p < ANALYSIS_PROTOCOLS; p++)
+    {
+      for (live = 0; live <= (b.live != NULL); live++)
+      {
+        fprintf(stderr, "%4.2f %-8s %-4s %5d %7.1f%% %8d %8.1f%%\n", u,
+                analysis_protocol_name((analysis_protocol)p), mode_names[live], b.nsets,
+                100.0 * ok[live][p] / b.nsets, dead[live][p], 100.0 * bounded[p] / b.nsets);
+      }
+    }
+  }
+
+  if (b.live != NULL)
+  {
+    remove(cfg);
+    remove(stats);
+    rmdir(tmp);
+  }
+  return 0;
+}
@@ -0,0 +1,173 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "metrics.h"
+#include "locks.h"
+
+/**
+ * Live monitor of a periodic_sr run started with -m name. Maps the
+ * metrics segment read-only and prints, every interval, the jobs, the
+ * deadline misses and the last and worst response time of every task,
+ * with the rates since the previous sample, and the lock contention on
+ * every resource. It never writes to the segment nor takes a lock that
+ * the real-time threads use, so it does not disturb the run; it stops
+ * when the run ends or its process disappears.
+ **/
+
+static void usage(const char *name)
+{
+  fprintf(stderr, "Usage: %s [-i seconds] [-n samples] shm-name\n", name);
+  exit(1);
+}
+
+static double now_s(void)
+{
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec / 1.0e9;
+}
+
+// Print the tasks (rates against *prev, which is updated) and resources
+static void sample(const struct metrics_header *h, uint64_t *prev_jobs, uint64_t *prev_misses,
+                   double elapsed)
+{
+  const struct task_metrics *tasks =
+      (const struct task_metrics *)((const char *)h + h->task_offset);
+  const struct lock_profile *profiles =
+      (const struct lock_profile *)((const char *)h + h->profile_offset);
+  uint64_t jobs, misses;
+  int64_t release, last, worst;
+  int i, k;
+
+  printf("  Task Prio       Jobs   Jobs/s   Misses  Miss/s   Last ms  Worst ms\n");
+  for (i = 0; i < h->ntasks; i++)
+  {
+    if (metrics_read(&tasks[i], &jobs, &misses, &release, &last, &worst) != 0)
+    {
+      printf("  %4d %4d   (record being written, writer stopped?)\n", tasks[i].id,
+             tasks[i].prio);
+      continue;
+    }
+    printf("  %4d %4d %10llu %8.1f %8llu %7.1f %9.3f %9.3f\n", tasks[i].id, tasks[i].prio,
+           (unsigned long long)jobs, elapsed > 0 ? (jobs - prev_jobs[i]) / elapsed : 0.0,
+           (unsigned long long)misses, elapsed > 0 ? (misses - prev_misses[i]) / elapsed : 0.0,
+           last / 1.0e6, worst / 1.0e6);
+    prev_jobs[i] = jobs;
+    prev_misses[i] = misses;
+  }
+
+  if (h->nresources == 0)
+    return;
+  printf("  Res  Task   Acquired  Contended  Wait avg ms  Wait max ms  Inversions  Inv max ms\n");
+  for (k = 0; k < h->nresources; k++)
+  {
+    for (i = 0; i < h->ntasks; i++)
+    {
+      const struct lock_profile *p = &profiles[k * h->ntasks + i];
+      uint64_t acquisitions = atomic_load_explicit(&p->acquisitions, memory_order_relaxed);
+      uint64_t contended = atomic_load_explicit(&p->contended, memory_order_relaxed);
+      uint64_t wait = atomic_load_explicit(&p->wait_total, memory_order_relaxed);
+
+      if (acquisitions == 0)
+        continue;
+      printf("  R%-3d %4d %10llu %10llu %12.3f %12.3f %11llu %11.3f\n", k + 1, tasks[i].id,
+             (unsigned long long)acquisitions, (unsigned long long)contended,
+             contended > 0 ? wait / 1.0e6 / contended : 0.0,
+             atomic_load_explicit(&p->wait_max, memory_order_relaxed) / 1.0e6,
+             (unsigned long long)atomic_load_explicit(&p->inversions, memory_order_relaxed),
+             atomic_load_explicit(&p->inversion_max, memory_order_relaxed) / 1.0e6);
+    }
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  struct metrics_header *h, probe;
+  struct timespec interval;
+  uint64_t *prev_jobs, *prev_misses;
+  double seconds = 1.0, start, last, t;
+  char name[256];
+  int samples = 0, opt, n, fd;
+
+  while ((opt = getopt(argc, argv, "i:n:")) != -1)
+  {
+    switch (opt)
+    {
+    case 'i':
+      seconds = atof(optarg);
+      if (seconds <= 0)
+        usage(argv[0]);
+      break;
+    case 'n':
+      samples = atoi(optarg);
+      break;
+    default:
+      usage(argv[0]);
+    }
+  }
+  if (optind != argc - 1)
+    usage(argv[0]);
+  snprintf(name, sizeof(name), "%s%s", argv[optind][0] == '/' ? "" : "/", argv[optind]);
+
+  fd = shm_open(name, O_RDONLY, 0);
+  if (fd < 0)
+  {
+    perror(name);
+    exit(1);
+  }
+  if (read(fd, &probe, sizeof(probe)) != sizeof(probe) ||
+      memcmp(probe.magic, METRICS_MAGIC, sizeof(probe.magic)) != 0)
+  {
+    fprintf(stderr, "%s: not a periodic_sr metrics segment (or not ready yet)\n", name);
+    exit(1);
+  }
+  if (probe.version != METRICS_VERSION)
+  {
+    fprintf(stderr, "%s: unsupported metrics version %u\n", name, probe.version);
+    exit(1);
+  }
+  h = mmap(NULL, probe.size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (h == MAP_FAILED)
+  {
+    perror("mmap");
+    exit(1);
+  }
+  prev_jobs = calloc(h->ntasks, sizeof(uint64_t));
+  prev_misses = calloc(h->ntasks, sizeof(uint64_t));
+  if (prev_jobs == NULL || prev_misses == NULL)
+  {
+    perror("calloc");
+    exit(1);
+  }
+
+  interval.tv_sec = (time_t)seconds;
+  interval.tv_nsec = (long)((seconds - interval.tv_sec) * 1.0e9);
+  start = last = now_s();
+  for (n = 0; samples == 0 || n < samples; n++)
+  {
+    int running = atomic_load(&h->running);
+    int alive = kill(h->pid, 0) == 0 || errno != ESRCH;
+
+    t = now_s();
+    printf("%s: pid %d, %s, %.1f s\n", name, h->pid,
+           running && alive ? "running" : running ? "writer gone" : "ended", t - start);
+    // The first sample has no previous one, so it shows no rates
+    sample(h, prev_jobs, prev_misses, n > 0 ? t - last : 0.0);
+    printf("\n");
+    fflush(stdout);
+    last = t;
+    if (!running || !alive)
+      break;
+    nanosleep(&interval, NULL);
+  }
+  return 0;
+}
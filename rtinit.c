@@ -0,0 +1,37 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "rtinit.h"
+
+int rt_lock_memory(void)
+{
+  if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+  {
+    printf("Warning: mlockall failed (%s), page faults may show up as latency\n",
+           strerror(errno));
+    return -1;
+  }
+  return 0;
+}
+
+void rt_prefault(void *p, size_t size)
+{
+  volatile char *c = p;
+  long page = sysconf(_SC_PAGESIZE);
+  size_t i;
+
+  for (i = 0; i < size; i += page)
+    c[i] = c[i];
+  if (size > 0)
+    c[size - 1] = c[size - 1];
+}
+
+// Not inlined, so that the array is really below the caller's frame
+__attribute__((noinline)) void rt_prefault_stack(void)
+{
+  volatile char stack[RT_STACK_PREFAULT];
+
+  rt_prefault((void *)stack, sizeof(stack));
+}
@@ -0,0 +1,31 @@
+#ifndef _RTINIT_H
+#define _RTINIT_H
+
+#include <stddef.h>
+
+/**
+ * @file rtinit.h
+ *
+ * Real-time startup. The whole address space is locked in RAM and the
+ * memory the periodic threads use (stacks, trace rings, histograms) is
+ * touched before the first release, so that no job takes a page fault
+ * that would then be reported as a worst-case response time.
+ **/
+
+// Stack size of every periodic thread
+#define RT_STACK_SIZE (256 * 1024)
+
+// Part of the stack touched by rt_prefault_stack() (what a job may use)
+#define RT_STACK_PREFAULT (64 * 1024)
+
+// mlockall() current and future mappings; prints a warning and returns -1
+// if it is not allowed (RLIMIT_MEMLOCK without root)
+extern int rt_lock_memory(void);
+
+// Write one byte of every page of [p, p + size)
+extern void rt_prefault(void *p, size_t size);
+
+// Touch RT_STACK_PREFAULT bytes of the calling thread's stack
+extern void rt_prefault_stack(void);
+
+#endif
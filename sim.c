@@ -0,0 +1,509 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "trace.h"
+#include "sim.h"
+
+// State of the current job of one task
+struct sim_job
+{
+  int active;          // a job has been released and has not ended
+  int started;         // its JOB_START has been emitted
+  int seg;             // segment being executed
+  int64_t left;        // time left in the current compute segment
+  int64_t release;     // nominal release time of the job
+  int64_t next;        // next release time (key of the release heap)
+  int64_t period;
+  int64_t deadline;    // relative deadline
+  int prio;            // effective priority (inherited or ceiling)
+  uint64_t seq;        // FIFO order among ready jobs of equal priority
+  int cpu;
+  int blocked;         // resource index it waits for, -1 if none
+  int64_t block_start;
+  int *held;           // resource indexes held, in lock order
+  int nheld;
+};
+
+struct sim
+{
+  const struct task_set *ts;
+  const struct sim_config *cfg;
+  struct sim_result *r;
+  struct sim_job *jobs;
+  int *owner;   // owner[k] is the job holding R(k+1), -1 if free
+  int *ceiling; // priority ceiling of every resource
+  int *heap;    // tasks waiting for their next release, by jobs[].next
+  int nheap;
+  int *running; // running[c] is the job chosen on CPU c, -1 if idle
+  int ncpus;
+  int64_t now;
+  uint64_t seq;
+};
+
+static int64_t ns(const struct timespec *t)
+{
+  return (int64_t)t->tv_sec * 1000000000 + t->tv_nsec;
+}
+
+static void emit(struct sim *s, int j, trace_kind kind, int resource, int64_t value)
+{
+  struct trace_event e;
+
+  if (!s->cfg->trace)
+    return;
+  e.timestamp = s->now;
+  e.value = value;
+  e.task_id = s->ts->tasks[j].id;
+  e.resource = resource;
+  e.kind = kind;
+  e.pad = 0;
+  trace_print_event(&e, 0);
+}
+
+static int heap_less(const struct sim *s, int a, int b)
+{
+  return s->jobs[a].next < s->jobs[b].next ||
+         (s->jobs[a].next == s->jobs[b].next && a < b);
+}
+
+static void heap_push(struct sim *s, int j)
+{
+  int i = s->nheap++;
+
+  while (i > 0 && heap_less(s, j, s->heap[(i - 1) / 2]))
+  {
+    s->heap[i] = s->heap[(i - 1) / 2];
+    i = (i - 1) / 2;
+  }
+  s->heap[i] = j;
+}
+
+static int heap_pop(struct sim *s)
+{
+  int top = s->heap[0];
+  int last = s->heap[--s->nheap];
+  int i = 0, c;
+
+  while ((c = 2 * i + 1) < s->nheap)
+  {
+    if (c + 1 < s->nheap && heap_less(s, s->heap[c + 1], s->heap[c]))
+      c++;
+    if (!heap_less(s, s->heap[c], last))
+      break;
+    s->heap[i] = s->heap[c];
+    i = c;
+  }
+  s->heap[i] = last;
+  return top;
+}
+
+// Set up the current segment: compute segments load their duration
+static void enter_segment(struct sim *s, int j)
+{
+  const struct periodic_data *d = &s->ts->tasks[j];
+  struct sim_job *job = &s->jobs[j];
+
+  if (job->seg < d->nsegments && d->segments[job->seg].kind == SEGMENT_COMPUTE)
+    job->left = ns(&d->segments[job->seg].time);
+  else
+    job->left = 0;
+}
+
+// Effective priority of job j under the simulated protocol
+static int effective_prio(const struct sim *s, int j)
+{
+  const struct sim_job *job = &s->jobs[j];
+  int prio = s->ts->tasks[j].prio;
+  int h, w;
+
+  for (h = 0; h < job->nheld; h++)
+  {
+    int k = job->held[h];
+
+    if (s->cfg->protocol == ANALYSIS_PCP && s->ceiling[k] > prio)
+      prio = s->ceiling[k];
+    if (s->cfg->protocol == ANALYSIS_PIP)
+    {
+      for (w = 0; w < s->ts->ntasks; w++)
+      {
+        if (s->jobs[w].blocked == k && s->jobs[w].prio > prio)
+          prio = s->jobs[w].prio;
+      }
+    }
+  }
+  return prio;
+}
+
+static void start_job(struct sim *s, int j, int64_t release)
+{
+  struct sim_job *job = &s->jobs[j];
+
+  job->active = 1;
+  job->started = 0;
+  job->seg = 0;
+  job->release = release;
+  job->prio = s->ts->tasks[j].prio;
+  job->seq = s->seq++;
+  enter_segment(s, j);
+}
+
+static void end_job(struct sim *s, int j)
+{
+  struct sim_job *job = &s->jobs[j];
+  struct sim_task_result *t = &s->r->tasks[j];
+  int64_t response = s->now - job->release;
+
+  emit(s, j, TRACE_JOB_END, 0, response);
+  t->jobs++;
+  if (response > job->deadline)
+  {
+    t->misses++;
+    emit(s, j, TRACE_DEADLINE_MISS, 0, response - job->deadline);
+  }
+  if (response > t->wcrt)
+  {
+    t->wcrt = response;
+    emit(s, j, TRACE_WCRT, 0, response);
+  }
+
+  // Like the periodic threads, a late job is followed at once by the next
+  // one, unless the releases already past are skipped
+  job->active = 0;
+  job->next = job->release + job->period;
+  while (s->cfg->overrun == OVERRUN_SKIP && job->next < s->now)
+  {
+    job->next += job->period;
+    t->skipped++;
+  }
+  if (job->next <= s->now)
+    start_job(s, j, job->next);
+  else
+    heap_push(s, j);
+}
+
+// Raise the owners along the wait-for chain of j (PIP); returns 1 if the
+// chain leads back to j
+static int propagate(struct sim *s, int j)
+{
+  int o = s->owner[s->jobs[j].blocked];
+  int steps;
+
+  for (steps = 0; o >= 0 && steps < s->ts->ntasks; steps++)
+  {
+    if (o == j)
+      return 1;
+    if (s->cfg->protocol == ANALYSIS_PIP && s->jobs[j].prio > s->jobs[o].prio)
+      s->jobs[o].prio = s->jobs[j].prio;
+    if (s->jobs[o].blocked < 0)
+      return 0;
+    o = s->owner[s->jobs[o].blocked];
+  }
+  return 0;
+}
+
+static void acquire(struct sim *s, int j, int k)
+{
+  struct sim_job *job = &s->jobs[j];
+
+  s->owner[k] = j;
+  job->held[job->nheld++] = k;
+  job->seg++;
+  enter_segment(s, j);
+  emit(s, j, TRACE_LOCK_ACQUIRED, k + 1, 0);
+}
+
+static void lock(struct sim *s, int j, int k)
+{
+  struct sim_job *job = &s->jobs[j];
+
+  emit(s, j, TRACE_LOCK_TRY, k + 1, 0);
+  if (s->owner[k] < 0)
+  {
+    acquire(s, j, k);
+    job->prio = effective_prio(s, j);
+    return;
+  }
+  job->blocked = k;
+  job->block_start = s->now;
+  if (propagate(s, j))
+  {
+    emit(s, j, TRACE_DEADLOCK, k + 1, 0);
+    s->r->deadlock = 1;
+  }
+}
+
+// Release R(k+1) and hand it to its highest-priority waiter
+static void release(struct sim *s, int j, int k)
+{
+  struct sim_job *job = &s->jobs[j];
+  int h, w, next = -1;
+
+  for (h = 0; h < job->nheld && job->held[h] != k; h++)
+    ;
+  memmove(&job->held[h], &job->held[h + 1], (job->nheld - h - 1) * sizeof(int));
+  job->nheld--;
+  s->owner[k] = -1;
+
+  for (w = 0; w < s->ts->ntasks; w++)
+  {
+    if (s->jobs[w].blocked == k &&
+        (next < 0 || s->jobs[w].prio > s->jobs[next].prio ||
+         (s->jobs[w].prio == s->jobs[next].prio &&
+          s->jobs[w].block_start < s->jobs[next].block_start)))
+      next = w;
+  }
+  if (next >= 0)
+  {
+    struct sim_job *waiter = &s->jobs[next];
+    struct sim_task_result *t = &s->r->tasks[next];
+
+    if (s->now - waiter->block_start > t->max_blocking)
+      t->max_blocking = s->now - waiter->block_start;
+    waiter->blocked = -1;
+    waiter->seq = s->seq++;
+    acquire(s, next, k);
+    waiter->prio = effective_prio(s, next);
+  }
+  job->prio = effective_prio(s, j);
+}
+
+static void unlock(struct sim *s, int j, int k)
+{
+  struct sim_job *job = &s->jobs[j];
+
+  job->seg++;
+  enter_segment(s, j);
+  emit(s, j, TRACE_LOCK_RELEASED, k + 1, 0);
+  release(s, j, k);
+}
+
+// Abort policy: a job is abandoned at the first segment boundary past its
+// deadline, giving back what it holds. Returns 1 if j was aborted
+static int abort_late(struct sim *s, int j)
+{
+  struct sim_job *job = &s->jobs[j];
+
+  if (s->cfg->overrun != OVERRUN_ABORT || job->seg == s->ts->tasks[j].nsegments ||
+      s->now <= job->release + job->deadline)
+    return 0;
+  while (job->nheld > 0)
+    release(s, j, job->held[job->nheld - 1]);
+  s->r->tasks[j].aborted++;
+  end_job(s, j);
+  return 1;
+}
+
+// Execute the zero-time action at the current segment of job j
+static void step(struct sim *s, int j)
+{
+  const struct periodic_data *d = &s->ts->tasks[j];
+  struct sim_job *job = &s->jobs[j];
+  const struct segment *seg;
+
+  if (abort_late(s, j))
+    return;
+  if (job->seg == d->nsegments)
+  {
+    end_job(s, j);
+    return;
+  }
+  seg = &d->segments[job->seg];
+  switch (seg->kind)
+  {
+  case SEGMENT_COMPUTE:
+    job->seg++;
+    enter_segment(s, j);
+    break;
+  case SEGMENT_LOCK:
+    lock(s, j, seg->resource - 1);
+    break;
+  case SEGMENT_UNLOCK:
+    unlock(s, j, seg->resource - 1);
+    break;
+  }
+}
+
+// Choose the running job of every CPU: highest priority, then FIFO
+static void dispatch(struct sim *s)
+{
+  int j, c;
+
+  for (c = 0; c < s->ncpus; c++)
+    s->running[c] = -1;
+  for (j = 0; j < s->ts->ntasks; j++)
+  {
+    const struct sim_job *job = &s->jobs[j];
+    int best;
+
+    if (!job->active || job->blocked >= 0)
+      continue;
+    best = s->running[job->cpu];
+    if (best < 0 || job->prio > s->jobs[best].prio ||
+        (job->prio == s->jobs[best].prio && job->seq < s->jobs[best].seq))
+      s->running[job->cpu] = j;
+  }
+}
+
+static void simulate(struct sim *s)
+{
+  int64_t end = s->cfg->duration;
+  int c, j, acted;
+
+  while (1)
+  {
+    int64_t next;
+
+    while (s->nheap > 0 && s->jobs[s->heap[0]].next <= s->now)
+    {
+      j = heap_pop(s);
+      start_job(s, j, s->jobs[j].next);
+    }
+    dispatch(s);
+    s->r->steps++;
+
+    // Zero-time actions (start, lock, unlock, end) may change priorities,
+    // so the dispatch is repeated after each one
+    acted = 0;
+    for (c = 0; c < s->ncpus && !acted; c++)
+    {
+      if ((j = s->running[c]) < 0)
+        continue;
+      if (!s->jobs[j].started)
+      {
+        s->jobs[j].started = 1;
+        emit(s, j, TRACE_JOB_START, 0, 0);
+        if (abort_late(s, j))
+        {
+          acted = 1;
+          continue;
+        }
+      }
+      if (s->jobs[j].left == 0)
+      {
+        step(s, j);
+        acted = 1;
+      }
+    }
+    if (acted)
+      continue;
+
+    // Advance to the next completion of a compute segment or release
+    next = end;
+    if (s->nheap > 0 && s->jobs[s->heap[0]].next < next)
+      next = s->jobs[s->heap[0]].next;
+    for (c = 0; c < s->ncpus; c++)
+    {
+      if ((j = s->running[c]) >= 0 && s->now + s->jobs[j].left < next)
+        next = s->now + s->jobs[j].left;
+    }
+    for (c = 0; c < s->ncpus; c++)
+    {
+      if ((j = s->running[c]) >= 0)
+        s->jobs[j].left -= next - s->now;
+    }
+    s->now = next;
+    if (s->now >= end)
+      break;
+  }
+  s->r->end = s->now;
+
+  // Jobs still pending past their period (starved or deadlocked) have
+  // missed their deadline too
+  for (j = 0; j < s->ts->ntasks; j++)
+  {
+    if (s->jobs[j].active && s->now - s->jobs[j].release > s->jobs[j].deadline)
+      s->r->tasks[j].misses++;
+  }
+}
+
+int sim_run(const struct task_set *ts, const struct sim_config *cfg,
+            struct sim_result *r)
+{
+  struct sim s;
+  int i, k, err = -1;
+
+  memset(&s, 0, sizeof(s));
+  memset(r, 0, sizeof(*r));
+  s.ts = ts;
+  s.cfg = cfg;
+  s.r = r;
+  s.ncpus = 1;
+  for (i = 0; i < ts->ntasks; i++)
+  {
+    if (ts->tasks[i].cpu >= s.ncpus)
+      s.ncpus = ts->tasks[i].cpu + 1;
+  }
+
+  r->ntasks = ts->ntasks;
+  r->tasks = calloc(ts->ntasks, sizeof(struct sim_task_result));
+  s.jobs = calloc(ts->ntasks, sizeof(struct sim_job));
+  s.heap = calloc(ts->ntasks, sizeof(int));
+  s.owner = calloc(ts->nresources ? ts->nresources : 1, sizeof(int));
+  s.ceiling = calloc(ts->nresources ? ts->nresources : 1, sizeof(int));
+  s.running = calloc(s.ncpus, sizeof(int));
+  if (r->tasks == NULL || s.jobs == NULL || s.heap == NULL || s.owner == NULL ||
+      s.ceiling == NULL || s.running == NULL)
+    goto out;
+
+  // Same ceilings as the mutexes created by main()
+  for (k = 0; k < ts->nresources; k++)
+  {
+    s.owner[k] = -1;
+    s.ceiling[k] = ts->resources[k].ceiling;
+  }
+  for (i = 0; i < ts->ntasks; i++)
+  {
+    struct sim_job *job = &s.jobs[i];
+
+    job->held = calloc(ts->nresources ? ts->nresources : 1, sizeof(int));
+    if (job->held == NULL)
+      goto out;
+    job->period = ns(&ts->tasks[i].period);
+    job->deadline = ns(&ts->tasks[i].deadline);
+    job->next = ns(&ts->tasks[i].phase);
+    job->cpu = ts->tasks[i].cpu < 0 ? 0 : ts->tasks[i].cpu;
+    job->blocked = -1;
+    heap_push(&s, i);
+  }
+
+  simulate(&s);
+  err = 0;
+
+out:
+  if (s.jobs != NULL)
+  {
+    for (i = 0; i < ts->ntasks; i++)
+      free(s.jobs[i].held);
+  }
+  free(s.jobs);
+  free(s.heap);
+  free(s.owner);
+  free(s.ceiling);
+  free(s.running);
+  if (err != 0)
+    sim_free(r);
+  return err;
+}
+
+void sim_print(const struct task_set *ts, const struct sim_result *r)
+{
+  int i;
+
+  printf("Simulated %.3f s in %lld steps%s\n", r->end / 1.0e9, (long long)r->steps,
+         r->deadlock ? " (deadlock)" : "");
+  printf("  Task     Jobs   Misses  Skipped  Aborted     WCRT  Lock wait\n");
+  for (i = 0; i < r->ntasks; i++)
+  {
+    const struct sim_task_result *t = &r->tasks[i];
+
+    printf("  %4d %8lld %8lld %8lld %8lld %8.3f %10.3f\n", ts->tasks[i].id,
+           (long long)t->jobs, (long long)t->misses, (long long)t->skipped,
+           (long long)t->aborted, t->wcrt / 1.0e9, t->max_blocking / 1.0e9);
+  }
+}
+
+void sim_free(struct sim_result *r)
+{
+  free(r->tasks);
+  memset(r, 0, sizeof(*r));
+}
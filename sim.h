@@ -0,0 +1,58 @@
+#ifndef _SIM_H
+#define _SIM_H
+
+#include <stdint.h>
+#include "taskset.h"
+#include "analysis.h"
+
+/**
+ * @file sim.h
+ *
+ * Discrete-event simulation of a task set in virtual time. Jobs follow
+ * the same bodies as the periodic threads under preemptive fixed
+ * priorities (FIFO among equal priorities, one scheduler per CPU in
+ * partitioned mode), with plain mutexes, priority inheritance or the
+ * immediate priority ceiling protocol. Compute segments take exactly
+ * their nominal time (the WCET, whatever their distribution, and no
+ * injected faults), so a run is deterministic, needs no real-time
+ * privileges and prints the same events as the live trace.
+ **/
+
+struct sim_config
+{
+  analysis_protocol protocol; // mutex protocol to simulate
+  int64_t duration;           // virtual time to simulate, in nanoseconds
+  int trace;                  // print every event to stdout
+  overrun_policy overrun;     // what a late job does, as in periodic()
+};
+
+// Per-task results, in nanoseconds
+struct sim_task_result
+{
+  int64_t jobs;         // completed jobs
+  int64_t wcrt;         // worst response time
+  int64_t misses;       // jobs that ended (or are still pending) after their deadline
+  int64_t skipped;      // releases dropped (OVERRUN_SKIP)
+  int64_t aborted;      // jobs abandoned (OVERRUN_ABORT)
+  int64_t max_blocking; // longest wait for a resource
+};
+
+struct sim_result
+{
+  int ntasks;
+  struct sim_task_result *tasks; // same order as task_set.tasks
+  int deadlock;   // some jobs ended in a wait-for cycle
+  int64_t steps;  // scheduling decisions taken
+  int64_t end;    // virtual time reached
+};
+
+// Simulate ts (priorities must already be assigned); -1 if out of memory
+extern int sim_run(const struct task_set *ts, const struct sim_config *cfg,
+                   struct sim_result *r);
+
+// Print the per-task results of a simulation
+extern void sim_print(const struct task_set *ts, const struct sim_result *r);
+
+extern void sim_free(struct sim_result *r);
+
+#endif
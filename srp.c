@@ -0,0 +1,233 @@
+#define _GNU_SOURCE // syscall
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <limits.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include "srp.h"
+
+static struct task_set *set;
+static int base_prio;                // SCHED_FIFO priority of relative priority 0
+static _Atomic int ceiling = -1;     // system ceiling, -1 if nothing is held
+static _Atomic int held[SRP_LEVELS]; // resources held, per ceiling
+static _Atomic uint32_t generation;  // futex of the gate, bumped when a resource is released
+static _Atomic int gate_waiters;
+
+// Raising a holder and restoring its priority are serialized, so that a
+// restore never runs before the raise it undoes. It is taken by the
+// real-time threads, and restore() lowers its caller while holding it,
+// so it uses inheritance (set up in srp_init)
+static pthread_mutex_t boost_lock;
+
+// Slow paths taken (a lock that never waits touches none of them)
+static _Atomic uint64_t gate_waits, word_waits, boosts;
+
+static __thread int self_tid;
+
+static long futex(_Atomic uint32_t *addr, int op, uint32_t val)
+{
+  return syscall(SYS_futex, addr, op, val, NULL, NULL, 0);
+}
+
+static int tid(void)
+{
+  if (self_tid == 0)
+    self_tid = (int)syscall(SYS_gettid);
+  return self_tid;
+}
+
+int srp_init(struct task_set *ts, int min_prio)
+{
+  pthread_mutexattr_t attr;
+  int i;
+
+  set = ts;
+  base_prio = min_prio;
+  pthread_mutexattr_init(&attr);
+  pthread_mutexattr_setprotocol(&attr, PTHREAD_PRIO_INHERIT);
+  i = pthread_mutex_init(&boost_lock, &attr);
+  pthread_mutexattr_destroy(&attr);
+  if (i != 0)
+  {
+    fprintf(stderr, "Cannot create the SRP boost lock\n");
+    return -1;
+  }
+  for (i = 0; i < ts->nresources; i++)
+  {
+    struct resource *r = &ts->resources[i];
+
+    if (r->ceiling < 0 || r->ceiling >= SRP_LEVELS)
+    {
+      fprintf(stderr, "R%d: ceiling %d out of the SRP range\n", r->id, r->ceiling);
+      return -1;
+    }
+    atomic_init(&r->word, 0);
+    atomic_init(&r->holder, 0);
+    atomic_init(&r->boosted, 0);
+  }
+  return 0;
+}
+
+// One more resource held with ceiling c
+static void raise_ceiling(int c)
+{
+  int cur = atomic_load(&ceiling);
+
+  atomic_fetch_add(&held[c], 1);
+  while (cur < c && !atomic_compare_exchange_weak(&ceiling, &cur, c))
+    ;
+}
+
+// One resource with ceiling c less: recompute the system ceiling and wake
+// up the jobs waiting at the gate. A raise in between makes the exchange
+// fail and the highest level is searched again
+static void lower_ceiling(int c)
+{
+  int cur, next;
+
+  if (atomic_fetch_sub(&held[c], 1) > 1)
+    return;
+  cur = atomic_load(&ceiling);
+  do
+  {
+    for (next = cur; next >= 0 && atomic_load(&held[next]) == 0; next--)
+      ;
+  } while (next != cur && !atomic_compare_exchange_weak(&ceiling, &cur, next));
+
+  // Sequentially consistent, like the gate: either a waiter sees the new
+  // ceiling or this sees the waiter
+  if (atomic_load(&gate_waiters) > 0)
+  {
+    atomic_fetch_add(&generation, 1);
+    futex(&generation, FUTEX_WAKE_PRIVATE, INT_MAX);
+  }
+}
+
+// A job of priority prio is about to wait: raise the holder of every
+// held resource with a ceiling at or above prio to that ceiling, unless
+// it already runs higher. The flag is set before the holder is checked
+// again, so that a holder releasing the resource at the same time either
+// is not raised or sees the flag
+static void boost_holders(int prio)
+{
+  struct sched_param p;
+  int k, t;
+
+  pthread_mutex_lock(&boost_lock);
+  for (k = 0; k < set->nresources; k++)
+  {
+    struct resource *r = &set->resources[k];
+
+    if (r->ceiling < prio || atomic_load(&r->word) == 0 || (t = atomic_load(&r->holder)) == 0)
+      continue;
+    atomic_store(&r->boosted, 1);
+    if (atomic_load(&r->word) == 0 || atomic_load(&r->holder) != t)
+      continue;
+    if (sched_getparam(t, &p) != 0 || p.sched_priority >= base_prio + r->ceiling)
+      continue;
+    p.sched_priority = base_prio + r->ceiling;
+    if (sched_setparam(t, &p) == 0)
+      atomic_fetch_add(&boosts, 1);
+  }
+  pthread_mutex_unlock(&boost_lock);
+}
+
+// Back to the priority of d, or to the highest ceiling of the raised
+// resources it still holds
+static void restore(const struct periodic_data *d)
+{
+  struct sched_param p;
+  int prio = d->prio, me = tid(), k;
+
+  pthread_mutex_lock(&boost_lock);
+  for (k = 0; k < set->nresources; k++)
+  {
+    struct resource *r = &set->resources[k];
+
+    if (atomic_load(&r->holder) == me && atomic_load(&r->boosted) && r->ceiling > prio)
+      prio = r->ceiling;
+  }
+  p.sched_priority = base_prio + prio;
+  sched_setparam(0, &p);
+  pthread_mutex_unlock(&boost_lock);
+}
+
+int srp_gate(const struct periodic_data *d)
+{
+  uint32_t gen;
+
+  if (atomic_load(&ceiling) < d->prio)
+    return 0;
+
+  atomic_fetch_add(&gate_waiters, 1);
+  if (atomic_load(&ceiling) >= d->prio)
+  {
+    atomic_fetch_add(&gate_waits, 1);
+    boost_holders(d->prio);
+  }
+  while ((gen = atomic_load(&generation), atomic_load(&ceiling) >= d->prio))
+    futex(&generation, FUTEX_WAIT_PRIVATE, gen);
+  atomic_fetch_sub(&gate_waiters, 1);
+  return 1;
+}
+
+// The ceiling is raised before the word is taken: a job released in
+// between is already held back at the gate
+void srp_lock(const struct periodic_data *d, struct resource *r)
+{
+  uint32_t c = 0;
+
+  raise_ceiling(r->ceiling);
+  if (!atomic_compare_exchange_strong(&r->word, &c, 1))
+  {
+    // Only with tasks on several CPUs, which the gate does not order:
+    // 2 tells the holder that somebody sleeps on the word
+    atomic_fetch_add(&word_waits, 1);
+    boost_holders(d->prio);
+    if (c != 2)
+      c = atomic_exchange(&r->word, 2);
+    while (c != 0)
+    {
+      futex(&r->word, FUTEX_WAIT_PRIVATE, 2);
+      c = atomic_exchange(&r->word, 2);
+    }
+  }
+  atomic_store(&r->holder, tid());
+}
+
+int srp_trylock(const struct periodic_data *d, struct resource *r)
+{
+  uint32_t c = 0;
+
+  (void)d;
+  raise_ceiling(r->ceiling);
+  if (!atomic_compare_exchange_strong(&r->word, &c, 1))
+  {
+    lower_ceiling(r->ceiling);
+    return EBUSY;
+  }
+  atomic_store(&r->holder, tid());
+  return 0;
+}
+
+void srp_unlock(const struct periodic_data *d, struct resource *r)
+{
+  atomic_store(&r->holder, 0);
+  if (atomic_exchange(&r->word, 0) == 2)
+    futex(&r->word, FUTEX_WAKE_PRIVATE, 1);
+  lower_ceiling(r->ceiling);
+  if (atomic_exchange(&r->boosted, 0))
+    restore(d);
+}
+
+void srp_report(FILE *f)
+{
+  fprintf(f, "SRP: %llu jobs waited at the gate, %llu locks waited on the word, "
+             "%llu holders raised to a ceiling\n",
+          (unsigned long long)atomic_load(&gate_waits),
+          (unsigned long long)atomic_load(&word_waits),
+          (unsigned long long)atomic_load(&boosts));
+}
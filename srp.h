@@ -0,0 +1,56 @@
+#ifndef _SRP_H
+#define _SRP_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "taskset.h"
+
+/**
+ * @file srp.h
+ *
+ * User-space priority-ceiling locks following the Stack Resource Policy
+ * (Baker), an alternative to PTHREAD_PRIO_PROTECT selected with -p srp.
+ * The system ceiling is the highest ceiling of the resources currently
+ * held. A job may only start once its priority is above the system
+ * ceiling (srp_gate); until then it sleeps on a futex. Every resource a
+ * started job locks is then free, so a lock is a compare-and-swap on the
+ * resource's futex word plus the ceiling bookkeeping, with no system
+ * call and no priority change: the tasks that could preempt the holder
+ * and use the resource are held back at the gate instead of by raising
+ * the holder's priority. The holder is only raised to the ceiling when a
+ * job actually waits for it (at the gate, or on the word if the gate was
+ * bypassed), so that threads outside the protocol cannot preempt it, and
+ * it returns to its own priority when it releases the resource.
+ *
+ * As under the immediate ceiling protocol, a job is blocked at most once,
+ * for one critical section of a lower-priority task, and no wait-for
+ * cycle can form. Both guarantees need every task on the same CPU.
+ **/
+
+// Priority levels of the ceiling bookkeeping (relative priorities)
+#define SRP_LEVELS 128
+
+// Prepare the SRP state of ts (resource words and ceilings); min_prio is
+// the SCHED_FIFO priority of relative priority 0. Returns -1 if a ceiling
+// is out of range
+extern int srp_init(struct task_set *ts, int min_prio);
+
+// Wait until the priority of d is above the system ceiling. Called at
+// the start of every job. Returns 1 if the job had to wait
+extern int srp_gate(const struct periodic_data *d);
+
+// Lock r on behalf of d: raise the system ceiling and take the word,
+// waiting for it only if the gate was bypassed
+extern void srp_lock(const struct periodic_data *d, struct resource *r);
+
+// Same as srp_lock if r is free; EBUSY otherwise
+extern int srp_trylock(const struct periodic_data *d, struct resource *r);
+
+// Release r, lower the system ceiling and let the jobs it held back start
+extern void srp_unlock(const struct periodic_data *d, struct resource *r);
+
+// Print how often the gate and the words made a job wait and how often a
+// holder had to be raised to its ceiling
+extern void srp_report(FILE *f);
+
+#endif
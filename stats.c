@@ -0,0 +1,233 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <signal.h>
+#include <pthread.h>
+#include "stats.h"
+#include "taskset.h"
+#include "locks.h"
+#include "timespec_operations.h"
+
+struct dumper_args
+{
+  const struct task_set *ts;
+  const char *path;
+};
+
+// Wake-up latency of the probe thread, if started
+static struct histogram probe;
+static int64_t probe_interval;
+
+// Largest value that falls in bucket b
+static uint64_t bucket_upper(int b)
+{
+  int shift;
+
+  if (b < HIST_SUB_BUCKETS)
+    return (uint64_t)b;
+  shift = (b >> HIST_SUB_BITS) - 1;
+  return (((uint64_t)HIST_SUB_BUCKETS + (b & (HIST_SUB_BUCKETS - 1))) << shift) +
+         ((uint64_t)1 << shift) - 1;
+}
+
+struct task_stats *stats_alloc(int n)
+{
+  return calloc(n, sizeof(struct task_stats));
+}
+
+uint64_t stats_percentile(const struct histogram *h, double p)
+{
+  uint64_t total = atomic_load_explicit(&h->total, memory_order_acquire);
+  uint64_t max = atomic_load_explicit(&h->max, memory_order_relaxed);
+  uint64_t rank, seen = 0;
+  int b;
+
+  if (total == 0)
+    return 0;
+  rank = (uint64_t)(p / 100.0 * total + 0.5);
+  if (rank < 1)
+    rank = 1;
+  for (b = 0; b < HIST_BUCKETS; b++)
+  {
+    seen += atomic_load_explicit(&h->count[b], memory_order_relaxed);
+    if (seen >= rank)
+      return bucket_upper(b) < max ? bucket_upper(b) : max;
+  }
+  return max;
+}
+
+static void dump_histogram(FILE *f, int id, const char *metric, const struct histogram *h)
+{
+  uint64_t n = atomic_load_explicit(&h->total, memory_order_acquire);
+
+  fprintf(f, "%d,%s,%llu,%llu,%llu,%llu,%llu,%llu,%llu\n", id, metric,
+          (unsigned long long)n,
+          (unsigned long long)atomic_load_explicit(&h->min, memory_order_relaxed),
+          (unsigned long long)(n ? atomic_load_explicit(&h->sum, memory_order_relaxed) / n : 0),
+          (unsigned long long)stats_percentile(h, 50.0),
+          (unsigned long long)stats_percentile(h, 99.0),
+          (unsigned long long)stats_percentile(h, 99.9),
+          (unsigned long long)atomic_load_explicit(&h->max, memory_order_relaxed));
+}
+
+void stats_dump(FILE *f, const struct task_set *ts)
+{
+  int i;
+
+  fprintf(f, "task,metric,count,min_ns,mean_ns,p50_ns,p99_ns,p999_ns,max_ns\n");
+  for (i = 0; i < ts->ntasks; i++)
+  {
+    const struct periodic_data *d = &ts->tasks[i];
+
+    dump_histogram(f, d->id, "response", &d->stats->response);
+    dump_histogram(f, d->id, "release_jitter", &d->stats->release_jitter);
+    dump_histogram(f, d->id, "lateness", &d->stats->lateness);
+    fprintf(f, "%d,skipped,%llu,0,0,0,0,0,0\n", d->id,
+            (unsigned long long)atomic_load_explicit(&d->stats->skipped, memory_order_relaxed));
+    fprintf(f, "%d,aborted,%llu,0,0,0,0,0,0\n", d->id,
+            (unsigned long long)atomic_load_explicit(&d->stats->aborted, memory_order_relaxed));
+  }
+  locks_dump_profile(f, ts);
+  if (probe_interval > 0)
+    dump_histogram(f, 0, "probe_latency", &probe);
+  fflush(f);
+}
+
+void stats_print_summary(FILE *f, const struct task_set *ts)
+{
+  int i;
+
+  fprintf(f, "Run summary:\n");
+  fprintf(f, "  Task     Jobs   Misses  Skipped  Aborted     Mean      P99     WCRT\n");
+  for (i = 0; i < ts->ntasks; i++)
+  {
+    const struct task_stats *st = ts->tasks[i].stats;
+    const struct histogram *h = &st->response;
+    uint64_t n = atomic_load_explicit(&h->total, memory_order_acquire);
+
+    fprintf(f, "  %4d %8llu %8llu %8llu %8llu %8.3f %8.3f %8.3f\n", ts->tasks[i].id,
+            (unsigned long long)n,
+            (unsigned long long)atomic_load_explicit(&st->lateness.total, memory_order_relaxed),
+            (unsigned long long)atomic_load_explicit(&st->skipped, memory_order_relaxed),
+            (unsigned long long)atomic_load_explicit(&st->aborted, memory_order_relaxed),
+            n ? atomic_load_explicit(&h->sum, memory_order_relaxed) / 1.0e9 / n : 0.0,
+            stats_percentile(h, 99.0) / 1.0e9,
+            atomic_load_explicit(&h->max, memory_order_relaxed) / 1.0e9);
+  }
+  fflush(f);
+}
+
+static void print_latency(FILE *f, const char *name, int id, const struct histogram *h)
+{
+  uint64_t n = atomic_load_explicit(&h->total, memory_order_acquire);
+
+  fprintf(f, "  %5s %4d %9llu %9.1f %9.1f %9.1f %9.1f\n", name, id, (unsigned long long)n,
+          atomic_load_explicit(&h->min, memory_order_relaxed) / 1.0e3,
+          n ? atomic_load_explicit(&h->sum, memory_order_relaxed) / 1.0e3 / n : 0.0,
+          atomic_load_explicit(&h->max, memory_order_relaxed) / 1.0e3,
+          stats_percentile(h, 99.0) / 1.0e3);
+}
+
+void stats_print_latency(FILE *f, const struct task_set *ts)
+{
+  int i;
+
+  fprintf(f, "Wake-up latency (us):\n");
+  fprintf(f, "  %5s %4s %9s %9s %9s %9s %9s\n", "", "Id", "Count", "Min", "Avg", "Max", "P99");
+  for (i = 0; i < ts->ntasks; i++)
+    print_latency(f, "task", ts->tasks[i].id, &ts->tasks[i].stats->release_jitter);
+  if (probe_interval > 0)
+    print_latency(f, "probe", 0, &probe);
+  fflush(f);
+}
+
+// Body of the dumper thread: wait for SIGUSR1 and write the statistics
+static void *dumper(void *arg)
+{
+  struct dumper_args *a = arg;
+  sigset_t set;
+  int sig;
+
+  sigemptyset(&set);
+  sigaddset(&set, SIGUSR1);
+  while (sigwait(&set, &sig) == 0)
+  {
+    FILE *f = a->path ? fopen(a->path, "w") : stdout;
+
+    if (f == NULL)
+    {
+      perror(a->path);
+      continue;
+    }
+    stats_dump(f, a->ts);
+    if (f != stdout)
+      fclose(f);
+  }
+  return NULL;
+}
+
+int stats_start_dumper(const struct task_set *ts, const char *path, int prio)
+{
+  static struct dumper_args args;
+  pthread_t th;
+  pthread_attr_t attr;
+  struct sched_param sch_param;
+  int err;
+
+  args.ts = ts;
+  args.path = path;
+
+  pthread_attr_init(&attr);
+  pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+  pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+  sch_param.sched_priority = prio;
+  pthread_attr_setschedparam(&attr, &sch_param);
+
+  err = pthread_create(&th, &attr, dumper, &args);
+  pthread_attr_destroy(&attr);
+  return err;
+}
+
+// Body of the probe thread: sleep until the next absolute wake-up time and
+// record how late it actually ran
+static void *prober(void *arg)
+{
+  struct timespec next, now, period;
+
+  (void)arg;
+  period.tv_sec = probe_interval / 1000000000;
+  period.tv_nsec = probe_interval % 1000000000;
+  clock_gettime(CLOCK_MONOTONIC, &next);
+  while (1)
+  {
+    incr_timespec(&next, &period);
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    decr_timespec(&now, &next);
+    hist_record(&probe, (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec);
+  }
+  return NULL;
+}
+
+int stats_start_probe(int64_t interval_ns, int prio)
+{
+  pthread_t th;
+  pthread_attr_t attr;
+  struct sched_param sch_param;
+  int err;
+
+  probe_interval = interval_ns;
+
+  pthread_attr_init(&attr);
+  pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+  pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+  sch_param.sched_priority = prio;
+  pthread_attr_setschedparam(&attr, &sch_param);
+
+  err = pthread_create(&th, &attr, prober, NULL);
+  pthread_attr_destroy(&attr);
+  if (err != 0)
+    probe_interval = 0;
+  return err;
+}
@@ -0,0 +1,117 @@
+#ifndef _STATS_H
+#define _STATS_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+/**
+ * @file stats.h
+ *
+ * Fixed-memory, log-bucketed histograms of per-task timings. Every
+ * power of two is split into 2^HIST_SUB_BITS linear buckets, so any
+ * percentile is known within 1/16 (6%) of its value, with a constant
+ * 5.6 KiB per histogram whatever the length of the run. Each histogram
+ * has a single writer (its periodic thread), which updates it without
+ * locks or read-modify-write instructions.
+ **/
+
+#define HIST_SUB_BITS 4
+#define HIST_SUB_BUCKETS (1 << HIST_SUB_BITS)
+#define HIST_MAX_BIT 47 // values are clamped to 2^48 ns (78 hours)
+#define HIST_BUCKETS ((HIST_MAX_BIT - HIST_SUB_BITS + 2) * HIST_SUB_BUCKETS)
+
+struct histogram
+{
+  _Atomic uint64_t count[HIST_BUCKETS];
+  _Atomic uint64_t total; // number of recorded values
+  _Atomic uint64_t min;
+  _Atomic uint64_t max;
+  _Atomic uint64_t sum;
+};
+
+// Statistics of one periodic thread, in nanoseconds
+struct task_stats
+{
+  struct histogram response;       // response time of every job
+  struct histogram release_jitter; // job start minus its release time
+                                   // (wake-up latency, preemption included)
+  struct histogram lateness;       // response minus deadline of missed jobs
+  _Atomic uint64_t skipped;        // releases dropped (OVERRUN_SKIP)
+  _Atomic uint64_t aborted;        // jobs abandoned (OVERRUN_ABORT)
+};
+
+struct task_set;
+
+// Allocate and zero n task_stats (one per task)
+extern struct task_stats *stats_alloc(int n);
+
+// Percentile p (0..100) of h, as the upper bound of its bucket
+extern uint64_t stats_percentile(const struct histogram *h, double p);
+
+// Write one CSV line per task and metric:
+//   task,metric,count,min_ns,mean_ns,p50_ns,p99_ns,p999_ns,max_ns
+// The lateness count is the number of deadline misses; the skipped and
+// aborted lines only fill in count. The lock contention profile follows
+// (see locks_dump_profile)
+extern void stats_dump(FILE *f, const struct task_set *ts);
+
+// Start a lowest-priority thread that dumps the statistics to path (or to
+// stdout if path is NULL) every time the process receives SIGUSR1.
+// SIGUSR1 must be blocked in every other thread
+extern int stats_start_dumper(const struct task_set *ts, const char *path, int prio);
+
+// Start a thread at SCHED_FIFO priority prio that wakes up every
+// interval_ns and records how late it woke up, like cyclictest. With
+// nothing of its own to do and the top priority, it measures the timer
+// and scheduler latency of the host, apart from any blocking on R1, R2...
+// Its histogram is dumped as task 0, metric probe_latency
+extern int stats_start_probe(int64_t interval_ns, int prio);
+
+// Print the jobs, deadline misses, skipped and aborted jobs and the mean,
+// p99 and worst response time of every task, in seconds
+extern void stats_print_summary(FILE *f, const struct task_set *ts);
+
+// Print min/avg/max/p99 of the wake-up latency (release jitter) of every
+// task and of the probe, in microseconds
+extern void stats_print_latency(FILE *f, const struct task_set *ts);
+
+// Bucket of a value
+static inline int hist_bucket(uint64_t v)
+{
+  int msb, shift;
+
+  if (v < HIST_SUB_BUCKETS)
+    return (int)v;
+  msb = 63 - __builtin_clzll(v);
+  if (msb > HIST_MAX_BIT)
+    return HIST_BUCKETS - 1;
+  shift = msb - HIST_SUB_BITS;
+  return ((shift + 1) << HIST_SUB_BITS) + (int)((v >> shift) & (HIST_SUB_BUCKETS - 1));
+}
+
+// Record a value; must only be called by the owner thread of h
+static inline void hist_record(struct histogram *h, uint64_t v)
+{
+  _Atomic uint64_t *c = &h->count[hist_bucket(v)];
+  uint64_t n = atomic_load_explicit(&h->total, memory_order_relaxed);
+
+  atomic_store_explicit(c, atomic_load_explicit(c, memory_order_relaxed) + 1,
+                        memory_order_relaxed);
+  if (n == 0 || v < atomic_load_explicit(&h->min, memory_order_relaxed))
+    atomic_store_explicit(&h->min, v, memory_order_relaxed);
+  if (v > atomic_load_explicit(&h->max, memory_order_relaxed))
+    atomic_store_explicit(&h->max, v, memory_order_relaxed);
+  atomic_store_explicit(&h->sum, atomic_load_explicit(&h->sum, memory_order_relaxed) + v,
+                        memory_order_relaxed);
+  atomic_store_explicit(&h->total, n + 1, memory_order_release);
+}
+
+// Add n to a counter; must only be called by its owner thread
+static inline void stats_count(_Atomic uint64_t *c, uint64_t n)
+{
+  atomic_store_explicit(c, atomic_load_explicit(c, memory_order_relaxed) + n,
+                        memory_order_relaxed);
+}
+
+#endif
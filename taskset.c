@@ -0,0 +1,860 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "timespec_operations.h"
+#include "taskset.h"
+
+#define LINE_MAX_LEN 4096
+
+// Parse a time in seconds ("0.025") into a timespec, rounding to the nanosecond
+static int parse_time(const char *text, struct timespec *t)
+{
+  char *end;
+  double secs = strtod(text, &end);
+  long long ns;
+
+  if (end == text || *end != '\0' || secs < 0)
+  {
+    return -1;
+  }
+  ns = (long long)(secs * 1.0e9 + 0.5);
+  t->tv_sec = ns / 1000000000;
+  t->tv_nsec = ns % 1000000000;
+  return 0;
+}
+
+// Parse a resource name "R<k>" into its number
+static int parse_resource(const char *text, int *res)
+{
+  char *end;
+
+  if (text[0] != 'R')
+  {
+    return -1;
+  }
+  *res = (int)strtol(text + 1, &end, 10);
+  if (end == text + 1 || *end != '\0' || *res <= 0)
+  {
+    return -1;
+  }
+  return 0;
+}
+
+// Read the execution times of an empirical distribution: one time in
+// seconds per line, none above the WCET of the segment
+static int load_samples(const char *path, int64_t wcet, struct exec_dist *dist)
+{
+  char line[LINE_MAX_LEN];
+  struct timespec t;
+  FILE *f;
+  int capacity = 0;
+
+  if ((dist->path = strdup(path)) == NULL || (f = fopen(path, "r")) == NULL)
+  {
+    perror(path);
+    return -1;
+  }
+  while (fgets(line, sizeof(line), f) != NULL)
+  {
+    line[strcspn(line, "#\r\n")] = '\0';
+    if (line[strspn(line, " \t")] == '\0')
+      continue;
+    if (parse_time(line + strspn(line, " \t"), &t) != 0 ||
+        (int64_t)t.tv_sec * 1000000000 + t.tv_nsec > wcet)
+    {
+      fprintf(stderr, "%s: bad time '%s' (seconds, at most the WCET)\n", path, line);
+      fclose(f);
+      return -1;
+    }
+    if (dist->nsamples == capacity)
+    {
+      int64_t *grown;
+
+      capacity = capacity ? 2 * capacity : 64;
+      if ((grown = realloc(dist->samples, capacity * sizeof(int64_t))) == NULL)
+      {
+        fclose(f);
+        return -1;
+      }
+      dist->samples = grown;
+    }
+    dist->samples[dist->nsamples++] = (int64_t)t.tv_sec * 1000000000 + t.tv_nsec;
+  }
+  fclose(f);
+  if (dist->nsamples == 0)
+  {
+    fprintf(stderr, "%s: no execution times\n", path);
+    return -1;
+  }
+  return 0;
+}
+
+// Parse the time of a compute segment: "<wcet>", or a distribution
+// "<low>..<wcet>", "<low>|<wcet>@<p>" or "<wcet>~<file>" into *dist. The
+// file name may contain anything, so '~' is looked for first
+static int parse_compute(char *text, struct segment *s, struct exec_dist **dist)
+{
+  struct timespec low;
+  char *sep, *at;
+
+  s->kind = SEGMENT_COMPUTE;
+  if ((sep = strchr(text, '~')) == NULL && (sep = strstr(text, "..")) == NULL &&
+      (sep = strchr(text, '|')) == NULL)
+  {
+    return parse_time(text, &s->time);
+  }
+  if ((*dist = calloc(1, sizeof(struct exec_dist))) == NULL)
+  {
+    return -1;
+  }
+  switch (*sep)
+  {
+  case '.':
+    *sep = '\0';
+    (*dist)->kind = EXEC_UNIFORM;
+    if (parse_time(text, &low) != 0 || parse_time(sep + 2, &s->time) != 0 ||
+        smaller_timespec(&s->time, &low))
+      return -1;
+    break;
+  case '|':
+    *sep = '\0';
+    (*dist)->kind = EXEC_BIMODAL;
+    if ((at = strchr(sep + 1, '@')) == NULL)
+      return -1;
+    *at = '\0';
+    (*dist)->p = strtod(at + 1, &at);
+    if (*at != '\0' || (*dist)->p < 0 || (*dist)->p > 1 || parse_time(text, &low) != 0 ||
+        parse_time(sep + 1, &s->time) != 0 || smaller_timespec(&s->time, &low))
+      return -1;
+    break;
+  default:
+    *sep = '\0';
+    (*dist)->kind = EXEC_EMPIRICAL;
+    if (parse_time(text, &s->time) != 0)
+      return -1;
+    return load_samples(sep + 1, (int64_t)s->time.tv_sec * 1000000000 + s->time.tv_nsec,
+                        *dist);
+  }
+  (*dist)->low = (int64_t)low.tv_sec * 1000000000 + low.tv_nsec;
+  return 0;
+}
+
+// Free the body of d and the distributions of its segments
+static void free_body(struct periodic_data *d)
+{
+  int i;
+
+  for (i = 0; d->dists != NULL && i < d->nsegments; i++)
+  {
+    if (d->dists[i] != NULL)
+    {
+      free(d->dists[i]->samples);
+      free(d->dists[i]->path);
+      free(d->dists[i]);
+    }
+  }
+  free(d->segments);
+  free(d->dists);
+  d->segments = NULL;
+  d->dists = NULL;
+  d->nsegments = 0;
+}
+
+// Parse a job body "C:0.03,L:R1,C:0.025,U:R1,..." into d->segments; M:, P:
+// and V: are compute segments with a load kernel other than the spin
+static int parse_body(char *text, struct periodic_data *d)
+{
+  char *tok, *save;
+  int n = 1, i;
+
+  for (i = 0; text[i] != '\0'; i++)
+  {
+    if (text[i] == ',')
+      n++;
+  }
+  free_body(d);
+  d->segments = calloc(n, sizeof(struct segment));
+  d->dists = calloc(n, sizeof(struct exec_dist *));
+  if (d->segments == NULL || d->dists == NULL)
+  {
+    return -1;
+  }
+  d->nsegments = 0;
+
+  for (tok = strtok_r(text, ",", &save); tok != NULL; tok = strtok_r(NULL, ",", &save))
+  {
+    struct segment *s = &d->segments[d->nsegments];
+
+    if (tok[0] == '\0' || tok[1] != ':')
+    {
+      return -1;
+    }
+    switch (tok[0])
+    {
+    case 'C':
+    case 'M':
+    case 'P':
+    case 'V':
+      // Counted before parsing, so that a distribution is freed on error
+      d->nsegments++;
+      s->load = tok[0] == 'M' ? LOAD_STREAM : tok[0] == 'P' ? LOAD_CHASE
+              : tok[0] == 'V' ? LOAD_SIMD : LOAD_SPIN;
+      if (parse_compute(tok + 2, s, &d->dists[d->nsegments - 1]) != 0)
+        return -1;
+      continue;
+    case 'L':
+      s->kind = SEGMENT_LOCK;
+      if (parse_resource(tok + 2, &s->resource) != 0)
+        return -1;
+      break;
+    case 'U':
+      s->kind = SEGMENT_UNLOCK;
+      if (parse_resource(tok + 2, &s->resource) != 0)
+        return -1;
+      break;
+    default:
+      return -1;
+    }
+    d->nsegments++;
+  }
+  return 0;
+}
+
+// Check that a body never locks a resource twice, never unlocks a resource
+// it does not hold and releases everything before the job ends
+static int check_body(const struct periodic_data *d, int nresources)
+{
+  char held[nresources + 1];
+  int i, nheld = 0;
+
+  memset(held, 0, sizeof(held));
+  for (i = 0; i < d->nsegments; i++)
+  {
+    const struct segment *s = &d->segments[i];
+
+    if (s->kind == SEGMENT_COMPUTE)
+      continue;
+    if (s->resource > nresources)
+      return -1;
+    if (s->kind == SEGMENT_LOCK)
+    {
+      if (held[s->resource])
+        return -1;
+      held[s->resource] = 1;
+      nheld++;
+    }
+    else
+    {
+      if (!held[s->resource])
+        return -1;
+      held[s->resource] = 0;
+      nheld--;
+    }
+  }
+  return nheld == 0 ? 0 : -1;
+}
+
+// Parse the key=value pairs of a "task" line into d
+static int parse_task(char *args, struct periodic_data *d, const char **bad)
+{
+  char *tok, *value, *end, *save;
+
+  memset(d, 0, sizeof(*d));
+  d->id = -1;
+  d->prio = -1;
+  d->cpu = -1;
+
+  for (tok = strtok_r(args, " \t", &save); tok != NULL; tok = strtok_r(NULL, " \t", &save))
+  {
+    *bad = tok;
+    value = strchr(tok, '=');
+    if (value == NULL)
+    {
+      return -1;
+    }
+    *value++ = '\0';
+
+    if (strcmp(tok, "id") == 0)
+    {
+      d->id = (int)strtol(value, &end, 10);
+      if (*end != '\0')
+        return -1;
+    }
+    else if (strcmp(tok, "prio") == 0)
+    {
+      d->prio = (int)strtol(value, &end, 10);
+      if (*end != '\0' || d->prio < TASKSET_MIN_PRIO)
+        return -1;
+    }
+    else if (strcmp(tok, "cpu") == 0)
+    {
+      d->cpu = (int)strtol(value, &end, 10);
+      if (*end != '\0' || d->cpu < 0)
+        return -1;
+    }
+    else if (strcmp(tok, "period") == 0)
+    {
+      if (parse_time(value, &d->period) != 0)
+        return -1;
+    }
+    else if (strcmp(tok, "deadline") == 0)
+    {
+      if (parse_time(value, &d->deadline) != 0)
+        return -1;
+    }
+    else if (strcmp(tok, "phase") == 0)
+    {
+      if (parse_time(value, &d->phase) != 0)
+        return -1;
+    }
+    else if (strcmp(tok, "ws") == 0)
+    {
+      // Bytes, with an optional K, M or G suffix
+      double bytes = strtod(value, &end);
+
+      const char *suffix = strchr("KMG", *end);
+
+      if (*end != '\0' && suffix != NULL)
+      {
+        bytes *= (double)(1L << (10 * (suffix - "KMG" + 1)));
+        end++;
+      }
+      if (*end != '\0' || bytes < 4096)
+        return -1;
+      d->ws = (size_t)bytes;
+    }
+    else if (strcmp(tok, "body") == 0)
+    {
+      if (parse_body(value, d) != 0)
+        return -1;
+    }
+    else
+    {
+      return -1;
+    }
+  }
+
+  *bad = "id/period/body";
+  if (d->id < 0 || (d->period.tv_sec == 0 && d->period.tv_nsec == 0) ||
+      d->nsegments == 0)
+  {
+    return -1;
+  }
+
+  // Constrained deadlines only: the analysis looks at one job per busy period
+  *bad = "deadline";
+  if (d->deadline.tv_sec == 0 && d->deadline.tv_nsec == 0)
+  {
+    d->deadline = d->period;
+  }
+  if (smaller_timespec(&d->period, &d->deadline))
+  {
+    return -1;
+  }
+  return 0;
+}
+
+// Parse the key=value pairs of a "fault" line into f
+static int parse_fault(char *args, struct fault *f, const char **bad)
+{
+  char *tok, *value, *end, *save;
+
+  memset(f, 0, sizeof(*f));
+  f->task = -1;
+  f->scale = 1.0;
+
+  for (tok = strtok_r(args, " \t", &save); tok != NULL; tok = strtok_r(NULL, " \t", &save))
+  {
+    *bad = tok;
+    value = strchr(tok, '=');
+    if (value == NULL)
+    {
+      return -1;
+    }
+    *value++ = '\0';
+
+    if (strcmp(tok, "task") == 0)
+    {
+      f->task = (int)strtol(value, &end, 10);
+      if (*end != '\0')
+        return -1;
+    }
+    else if (strcmp(tok, "every") == 0)
+    {
+      f->every = (int)strtol(value, &end, 10);
+      if (*end != '\0' || f->every <= 0)
+        return -1;
+    }
+    else if (strcmp(tok, "prob") == 0)
+    {
+      f->prob = strtod(value, &end);
+      if (*end != '\0' || f->prob <= 0 || f->prob > 1)
+        return -1;
+    }
+    else if (strcmp(tok, "scale") == 0)
+    {
+      f->scale = strtod(value, &end);
+      if (*end != '\0' || f->scale <= 0)
+        return -1;
+    }
+    else if (strcmp(tok, "in") == 0)
+    {
+      if (parse_resource(value, &f->resource) != 0)
+        return -1;
+    }
+    else
+    {
+      return -1;
+    }
+  }
+
+  *bad = "task/every/prob";
+  if (f->task < 0 || (f->every == 0) == (f->prob == 0))
+  {
+    return -1;
+  }
+  return 0;
+}
+
+// Attach every fault to its task: the task must exist, have no other
+// fault and lock the resource of the fault, if any
+static int attach_faults(struct task_set *ts, struct fault *faults, int nfaults, const char *path)
+{
+  int i, k;
+
+  for (i = 0; i < nfaults; i++)
+  {
+    struct periodic_data *d = NULL;
+    int locks = faults[i].resource == 0;
+
+    for (k = 0; k < ts->ntasks; k++)
+    {
+      if (ts->tasks[k].id == faults[i].task)
+        d = &ts->tasks[k];
+    }
+    for (k = 0; d != NULL && k < d->nsegments; k++)
+    {
+      locks |= (d->segments[k].kind == SEGMENT_LOCK &&
+                d->segments[k].resource == faults[i].resource);
+    }
+    if (d == NULL || d->fault != NULL || !locks)
+    {
+      fprintf(stderr, "%s: fault for task %d: no such task, a second fault or a resource it "
+                      "does not lock\n", path, faults[i].task);
+      return -1;
+    }
+    if ((d->fault = malloc(sizeof(struct fault))) == NULL)
+    {
+      return -1;
+    }
+    *d->fault = faults[i];
+  }
+  return 0;
+}
+
+int taskset_read(FILE *f, const char *path, struct task_set *ts)
+{
+  char line[LINE_MAX_LEN];
+  int lineno = 0, capacity = 0, i;
+  struct fault *faults = NULL;
+  int nfaults = 0;
+
+  memset(ts, 0, sizeof(*ts));
+  while (fgets(line, sizeof(line), f) != NULL)
+  {
+    char *p, *keyword;
+    const char *bad = "";
+
+    lineno++;
+    if ((p = strchr(line, '#')) != NULL)
+      *p = '\0';
+    keyword = line + strspn(line, " \t\r\n");
+    if (*keyword == '\0')
+      continue;
+    p = keyword + strcspn(keyword, " \t\r\n");
+    if (*p != '\0')
+      *p++ = '\0';
+    p[strcspn(p, "\r\n")] = '\0';
+
+    if (strcmp(keyword, "resources") == 0)
+    {
+      ts->nresources = atoi(p);
+      if (ts->nresources <= 0 || ts->resources != NULL)
+      {
+        fprintf(stderr, "%s:%d: bad resources line\n", path, lineno);
+        goto error;
+      }
+      ts->resources = calloc(ts->nresources, sizeof(struct resource));
+      if (ts->resources == NULL)
+      {
+        fprintf(stderr, "%s:%d: out of memory\n", path, lineno);
+        goto error;
+      }
+      for (i = 0; i < ts->nresources; i++)
+      {
+        ts->resources[i].id = i + 1;
+      }
+    }
+    else if (strcmp(keyword, "task") == 0)
+    {
+      if (ts->ntasks == capacity)
+      {
+        struct periodic_data *grown;
+
+        capacity = capacity ? 2 * capacity : 16;
+        grown = realloc(ts->tasks, capacity * sizeof(struct periodic_data));
+        if (grown == NULL)
+        {
+          fprintf(stderr, "%s:%d: out of memory\n", path, lineno);
+          goto error;
+        }
+        ts->tasks = grown;
+      }
+      if (parse_task(p, &ts->tasks[ts->ntasks], &bad) != 0)
+      {
+        free_body(&ts->tasks[ts->ntasks]);
+        fprintf(stderr, "%s:%d: bad task parameter '%s'\n", path, lineno, bad);
+        goto error;
+      }
+      ts->ntasks++;
+    }
+    else if (strcmp(keyword, "fault") == 0)
+    {
+      struct fault *grown = realloc(faults, (nfaults + 1) * sizeof(struct fault));
+
+      if (grown == NULL)
+      {
+        fprintf(stderr, "%s:%d: out of memory\n", path, lineno);
+        goto error;
+      }
+      faults = grown;
+      if (parse_fault(p, &faults[nfaults], &bad) != 0)
+      {
+        fprintf(stderr, "%s:%d: bad fault parameter '%s'\n", path, lineno, bad);
+        goto error;
+      }
+      nfaults++;
+    }
+    else
+    {
+      fprintf(stderr, "%s:%d: unknown keyword '%s'\n", path, lineno, keyword);
+      goto error;
+    }
+  }
+
+  if (ts->ntasks == 0)
+  {
+    fprintf(stderr, "%s: no tasks\n", path);
+    goto error;
+  }
+
+  // Bind the resource numbers to their mutexes
+  for (i = 0; i < ts->ntasks; i++)
+  {
+    struct periodic_data *d = &ts->tasks[i];
+    int k;
+
+    if (check_body(d, ts->nresources) != 0)
+    {
+      fprintf(stderr, "%s: task %d has unbalanced or undeclared locks\n", path, d->id);
+      goto error;
+    }
+    for (k = 0; k < d->nsegments; k++)
+    {
+      struct segment *s = &d->segments[k];
+
+      if (s->kind != SEGMENT_COMPUTE)
+      {
+        s->res = &ts->resources[s->resource - 1];
+      }
+    }
+  }
+  if (attach_faults(ts, faults, nfaults, path) != 0)
+  {
+    goto error;
+  }
+  free(faults);
+  return 0;
+
+error:
+  free(faults);
+  taskset_free(ts);
+  return -1;
+}
+
+int taskset_load(const char *path, struct task_set *ts)
+{
+  FILE *f;
+  int err;
+
+  if ((f = fopen(path, "r")) == NULL)
+  {
+    memset(ts, 0, sizeof(*ts));
+    perror(path);
+    return -1;
+  }
+  err = taskset_read(f, path, ts);
+  fclose(f);
+  return err;
+}
+
+void taskset_write(FILE *f, const struct task_set *ts)
+{
+  int i, k;
+
+  if (ts->nresources > 0)
+    fprintf(f, "resources %d\n", ts->nresources);
+  for (i = 0; i < ts->ntasks; i++)
+  {
+    const struct periodic_data *d = &ts->tasks[i];
+
+    fprintf(f, "task id=%d period=%.9f deadline=%.9f phase=%.9f prio=%d", d->id,
+            t2d(d->period), t2d(d->deadline), t2d(d->phase), d->prio);
+    if (d->cpu >= 0)
+      fprintf(f, " cpu=%d", d->cpu);
+    if (d->ws > 0)
+      fprintf(f, " ws=%zu", d->ws);
+    fprintf(f, " body=");
+    for (k = 0; k < d->nsegments; k++)
+    {
+      const struct segment *s = &d->segments[k];
+      const struct exec_dist *dist = d->dists[k];
+      char c = "CMPV"[s->kind == SEGMENT_COMPUTE ? s->load : 0];
+
+      if (s->kind != SEGMENT_COMPUTE)
+        fprintf(f, "%s%c:R%d", k ? "," : "", s->kind == SEGMENT_LOCK ? 'L' : 'U', s->resource);
+      else if (dist == NULL)
+        fprintf(f, "%s%c:%.9f", k ? "," : "", c, t2d(s->time));
+      else if (dist->kind == EXEC_UNIFORM)
+        fprintf(f, "%s%c:%.9f..%.9f", k ? "," : "", c, dist->low / 1.0e9, t2d(s->time));
+      else if (dist->kind == EXEC_BIMODAL)
+        fprintf(f, "%s%c:%.9f|%.9f@%g", k ? "," : "", c, dist->low / 1.0e9, t2d(s->time),
+                dist->p);
+      else
+        fprintf(f, "%s%c:%.9f~%s", k ? "," : "", c, t2d(s->time), dist->path);
+    }
+    fprintf(f, "\n");
+  }
+  for (i = 0; i < ts->ntasks; i++)
+  {
+    const struct fault *fault = ts->tasks[i].fault;
+
+    if (fault == NULL)
+      continue;
+    fprintf(f, "fault task=%d ", fault->task);
+    if (fault->every > 0)
+      fprintf(f, "every=%d", fault->every);
+    else
+      fprintf(f, "prob=%g", fault->prob);
+    fprintf(f, " scale=%g", fault->scale);
+    if (fault->resource > 0)
+      fprintf(f, " in=R%d", fault->resource);
+    fprintf(f, "\n");
+  }
+}
+
+// qsort helper: order task pointers by increasing deadline
+static int by_deadline(const void *a, const void *b)
+{
+  const struct periodic_data *da = *(struct periodic_data *const *)a;
+  const struct periodic_data *db = *(struct periodic_data *const *)b;
+
+  if (smaller_timespec(&da->deadline, &db->deadline))
+    return -1;
+  if (smaller_timespec(&db->deadline, &da->deadline))
+    return 1;
+  return 0;
+}
+
+void taskset_assign_priorities(struct task_set *ts, int max_prio)
+{
+  struct periodic_data **order = malloc(ts->ntasks * sizeof(*order));
+  int *rank = malloc(ts->ntasks * sizeof(*rank));
+  int levels = max_prio - TASKSET_MIN_PRIO + 1;
+  int n = 0, distinct = 0, i;
+
+  for (i = 0; i < ts->ntasks; i++)
+  {
+    if (ts->tasks[i].prio < 0)
+    {
+      order[n++] = &ts->tasks[i];
+    }
+  }
+  qsort(order, n, sizeof(*order), by_deadline);
+
+  // Equal deadlines share a rank
+  for (i = 0; i < n; i++)
+  {
+    if (i > 0 && by_deadline(&order[i - 1], &order[i]) != 0)
+    {
+      distinct++;
+    }
+    rank[i] = distinct;
+  }
+  distinct++;
+
+  // The longest deadline gets TASKSET_MIN_PRIO; when there are more
+  // distinct deadlines than priority levels, neighbouring ones share a level
+  for (i = 0; i < n; i++)
+  {
+    int from_bottom = distinct - 1 - rank[i];
+
+    if (distinct > levels)
+    {
+      from_bottom = (int)((long)from_bottom * levels / distinct);
+    }
+    order[i]->prio = TASKSET_MIN_PRIO + from_bottom;
+  }
+
+  free(rank);
+  free(order);
+  taskset_compute_ceilings(ts);
+}
+
+void taskset_compute_ceilings(struct task_set *ts)
+{
+  int top = taskset_max_prio(ts);
+  int i, k;
+
+  for (k = 0; k < ts->nresources; k++)
+  {
+    ts->resources[k].ceiling = ts->resources[k].global ? top + 1 : TASKSET_MIN_PRIO;
+  }
+  for (i = 0; i < ts->ntasks; i++)
+  {
+    const struct periodic_data *d = &ts->tasks[i];
+
+    for (k = 0; k < d->nsegments; k++)
+    {
+      struct resource *r = d->segments[k].res;
+
+      if (d->segments[k].kind == SEGMENT_LOCK && d->prio > r->ceiling)
+      {
+        r->ceiling = d->prio;
+      }
+    }
+  }
+}
+
+int taskset_check_ceilings(const struct task_set *ts, int max_prio)
+{
+  int i, k;
+
+  for (i = 0; i < ts->ntasks; i++)
+  {
+    const struct periodic_data *d = &ts->tasks[i];
+
+    if (d->prio < TASKSET_MIN_PRIO || d->prio > max_prio)
+    {
+      fprintf(stderr, "Task %d: priority %d out of range [%d, %d]\n", d->id, d->prio,
+              TASKSET_MIN_PRIO, max_prio);
+      return -1;
+    }
+    for (k = 0; k < d->nsegments; k++)
+    {
+      const struct resource *r = d->segments[k].res;
+
+      if (d->segments[k].kind == SEGMENT_LOCK && d->prio > r->ceiling)
+      {
+        fprintf(stderr, "Task %d: priority %d above the ceiling %d of R%d\n", d->id, d->prio,
+                r->ceiling, r->id);
+        return -1;
+      }
+    }
+  }
+  for (k = 0; k < ts->nresources; k++)
+  {
+    if (ts->resources[k].ceiling > max_prio)
+    {
+      fprintf(stderr, "R%d: ceiling %d above the highest priority %d\n", ts->resources[k].id,
+              ts->resources[k].ceiling, max_prio);
+      return -1;
+    }
+  }
+  return 0;
+}
+
+struct timespec taskset_wcet(const struct periodic_data *d)
+{
+  struct timespec c = {0, 0};
+  int i;
+
+  for (i = 0; i < d->nsegments; i++)
+  {
+    if (d->segments[i].kind == SEGMENT_COMPUTE)
+    {
+      incr_timespec(&c, &d->segments[i].time);
+    }
+  }
+  return c;
+}
+
+int taskset_parse_overrun(const char *name, overrun_policy *p)
+{
+  if (strcmp(name, "catchup") == 0)
+    *p = OVERRUN_CATCH_UP;
+  else if (strcmp(name, "skip") == 0)
+    *p = OVERRUN_SKIP;
+  else if (strcmp(name, "abort") == 0)
+    *p = OVERRUN_ABORT;
+  else
+    return -1;
+  return 0;
+}
+
+static int64_t gcd(int64_t a, int64_t b)
+{
+  while (b != 0)
+  {
+    int64_t t = a % b;
+
+    a = b;
+    b = t;
+  }
+  return a;
+}
+
+int64_t taskset_hyperperiod(const struct task_set *ts)
+{
+  int64_t h = 1;
+  int i;
+
+  for (i = 0; i < ts->ntasks; i++)
+  {
+    int64_t t = (int64_t)ts->tasks[i].period.tv_sec * 1000000000 + ts->tasks[i].period.tv_nsec;
+    int64_t f = t / gcd(h, t);
+
+    if (h > INT64_MAX / f)
+      return -1;
+    h *= f;
+  }
+  return h;
+}
+
+int taskset_max_prio(const struct task_set *ts)
+{
+  int i, max = 0;
+
+  for (i = 0; i < ts->ntasks; i++)
+  {
+    if (ts->tasks[i].prio > max)
+    {
+      max = ts->tasks[i].prio;
+    }
+  }
+  return max;
+}
+
+void taskset_free(struct task_set *ts)
+{
+  int i;
+
+  for (i = 0; i < ts->ntasks; i++)
+  {
+    free_body(&ts->tasks[i]);
+    free(ts->tasks[i].fault);
+  }
+  free(ts->tasks);
+  free(ts->resources);
+  memset(ts, 0, sizeof(*ts));
+}
@@ -0,0 +1,197 @@
+#ifndef _TASKSET_H
+#define _TASKSET_H
+
+#include <stdio.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+#include "trace.h"
+#include "stats.h"
+
+/**
+ * @file taskset.h
+ *
+ * Task-set description shared by the periodic threads and main(), and a
+ * loader that reads it from a text file (see tasks.cfg for the format).
+ **/
+
+// Lowest priority given to a periodic thread, relative to
+// sched_get_priority_min(SCHED_FIFO); the levels below are kept for the
+// trace drainer
+#define TASKSET_MIN_PRIO 2
+
+// Highest priority given to a periodic thread, relative like
+// TASKSET_MIN_PRIO: the two levels at the top of the SCHED_FIFO range are
+// kept for the main program and the latency probe
+#define TASKSET_MAX_PRIO \
+  (sched_get_priority_max(SCHED_FIFO) - sched_get_priority_min(SCHED_FIFO) - 2)
+
+struct lock_profile;
+struct task_metrics;
+struct load_arena;
+
+// A shared resource (R1, R2, ...)
+struct resource
+{
+  pthread_mutex_t mutex;
+  int id;            // resource number, as written in the task-set file
+  _Atomic int owner; // index of the task holding it, -1 if free (locks.h)
+  int global;        // used from more than one CPU (partition.h)
+  struct lock_profile *profile; // profile[task index] (locks.h)
+  int ceiling;       // priority ceiling, relative like the task priorities
+  _Atomic uint32_t word; // SRP lock: 0 free, 1 held, 2 held with waiters (srp.h)
+  _Atomic int holder;    // thread id holding it under SRP, 0 if none
+  _Atomic int boosted;   // a waiter raised its holder to the ceiling
+};
+
+typedef enum
+{
+  SEGMENT_COMPUTE, // execute for time
+  SEGMENT_LOCK,    // lock resource
+  SEGMENT_UNLOCK   // unlock resource
+} segment_kind;
+
+// What a compute segment executes (load.h): the calibrated spin of eat()
+// ("C:"), or a fixed amount of work on the task's arena that takes the
+// segment's time when the task runs alone
+typedef enum
+{
+  LOAD_SPIN,   // "C:" register-only busy wait
+  LOAD_STREAM, // "M:" streaming read-modify-write over the working set
+  LOAD_CHASE,  // "P:" dependent loads along a random cycle of cache lines
+  LOAD_SIMD,   // "V:" vector multiply-adds on data in the L1 cache
+  LOAD_KERNELS
+} load_kind;
+
+// Execution-time distribution of a compute segment, whose time is always
+// its largest value (the WCET used by the analysis and the simulator)
+typedef enum
+{
+  EXEC_UNIFORM,  // "C:<low>..<wcet>": uniform between low and the WCET
+  EXEC_BIMODAL,  // "C:<low>|<wcet>@<p>": the WCET with probability p, else low
+  EXEC_EMPIRICAL // "C:<wcet>~<file>": one of the times of the file (one per line)
+} exec_kind;
+
+struct exec_dist
+{
+  int kind;          // one of exec_kind
+  int64_t low;       // UNIFORM and BIMODAL, in nanoseconds
+  double p;          // BIMODAL
+  int64_t *samples;  // EMPIRICAL, in nanoseconds
+  int nsamples;
+  char *path;        // EMPIRICAL, as written in the body
+};
+
+// One step of a job body (24 bytes, stored contiguously per task). The
+// distributions are kept apart (periodic_data.dists), as only the jobs
+// that draw a time read them
+struct segment
+{
+  short kind;   // one of segment_kind
+  short load;   // SEGMENT_COMPUTE: one of load_kind
+  int resource; // resource number (1 for R1, ...) for LOCK and UNLOCK
+  union
+  {
+    struct timespec time;   // SEGMENT_COMPUTE
+    struct resource *res;   // SEGMENT_LOCK and SEGMENT_UNLOCK
+  };
+};
+
+// Fault injected in some jobs of a task ("fault task=<id> every=<n>|prob=<p>
+// scale=<x> [in=Rk]"): their compute segments, or only those executed
+// while holding Rk, take scale times their WCET
+struct fault
+{
+  int task;                  // id of the task
+  int every;                 // every n-th job, 0 if chosen at random
+  double prob;               // probability of each job, if every == 0
+  double scale;
+  int resource;              // resource number, 0 for every compute segment
+  _Atomic uint64_t injected; // faulty jobs so far
+};
+
+// What a periodic thread does when a job overruns its deadline
+typedef enum
+{
+  OVERRUN_CATCH_UP, // release the late jobs back to back
+  OVERRUN_SKIP,     // drop the releases that are already in the past
+  OVERRUN_ABORT     // abandon the job at the first segment past its deadline
+} overrun_policy;
+
+// Structure containing the parameters of each periodic thread
+struct periodic_data
+{
+  struct timespec period;   // period
+  struct timespec deadline; // relative deadline (<= period, default period)
+  struct timespec phase;    // initial phase to start the thread
+  struct timespec wcrt;     // worst-case response time
+  struct segment *segments; // job body, executed in order
+  struct exec_dist **dists; // dists[k]: distribution of segments[k], NULL if
+                            // it always takes its time
+  int nsegments;            // number of segments in the body
+  int id;                   // thread identifier
+  int prio;                 // priority relative to the SCHED_FIFO minimum
+  int cpu;                  // CPU the thread is pinned to, -1 if none
+  struct trace_ring *trace; // per-thread trace buffer
+  struct task_stats *stats; // response-time and jitter histograms
+  struct task_metrics *metrics; // live counters in shared memory, NULL if not published
+  int index;                // position in task_set.tasks
+  _Atomic int waiting_for;  // resource index it is blocked on, -1 if none
+  int *held;                // indexes of the resources it holds, in lock order
+  int nheld;
+  int *cycle;               // scratch of the deadlock detector (locks.h)
+  uint64_t rng;             // state of its random stream (workload.h)
+  uint64_t jobs;            // jobs started
+  struct fault *fault;      // fault injected in some of its jobs, NULL if none
+  size_t ws;                // working set of its M: and P: segments, in bytes
+  struct load_arena *arena; // memory of its load kernels, NULL if none
+};
+
+struct task_set
+{
+  int ntasks;
+  struct periodic_data *tasks;
+  int nresources;
+  struct resource *resources; // resources[k] is R(k+1)
+};
+
+// Read a task-set file; prints the offending line and returns -1 on error
+extern int taskset_load(const char *path, struct task_set *ts);
+
+// Same as taskset_load on an open stream; path only names it in messages
+extern int taskset_read(FILE *f, const char *path, struct task_set *ts);
+
+// Write ts in the task-set file format, with every priority explicit
+extern void taskset_write(FILE *f, const struct task_set *ts);
+
+// Give every task without an explicit priority a deadline-monotonic one
+// (shorter deadline, higher priority; rate-monotonic when D = T) within
+// [TASKSET_MIN_PRIO, max_prio], then compute the ceilings
+extern void taskset_assign_priorities(struct task_set *ts, int max_prio);
+
+// Set the ceiling of every resource to the highest priority of the tasks
+// that lock it, one level above the highest task priority if it is global
+// (MPCP); a resource nobody locks gets TASKSET_MIN_PRIO
+extern void taskset_compute_ceilings(struct task_set *ts);
+
+// Check that every priority and ceiling is within [TASKSET_MIN_PRIO,
+// max_prio] and that no task locks a resource whose ceiling is below its
+// priority (EINVAL under PTHREAD_PRIO_PROTECT); prints the first problem
+// and returns -1
+extern int taskset_check_ceilings(const struct task_set *ts, int max_prio);
+
+// Sum of the compute segments of a task (its C)
+extern struct timespec taskset_wcet(const struct periodic_data *d);
+
+// Parse "catchup", "skip" or "abort"; -1 if unknown
+extern int taskset_parse_overrun(const char *name, overrun_policy *p);
+
+// Least common multiple of the periods in nanoseconds, -1 if it overflows
+extern int64_t taskset_hyperperiod(const struct task_set *ts);
+
+// Highest priority of all the tasks
+extern int taskset_max_prio(const struct task_set *ts);
+
+extern void taskset_free(struct task_set *ts);
+
+#endif
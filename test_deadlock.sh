@@ -9,7 +9,7 @@ echo ""
 
 # Compilar
 echo "Compilando el programa..."
-gcc -o periodic_sr periodic_sr.c eat.c -lpthread -lrt -Wall
+gcc -o periodic_sr periodic_sr.c eat.c trace.c taskset.c analysis.c stats.c locks.c partition.c sim.c rtinit.c edf.c dispatch.c metrics.c workload.c load.c srp.c -lpthread -lrt -Wall
 if [ $? -ne 0 ]; then
     echo "Error en compilación"
     exit 1
@@ -27,7 +27,7 @@ fi
 # Función para ejecutar test
 run_test() {
     local protocol=$1
-    local timeout=$2
+    local length=$2
     local description=$3
     
     echo "=========================================="
@@ -35,21 +35,18 @@ run_test() {
     echo "=========================================="
     echo ""
     
-    # Ejecutar con timeout
-    timeout $timeout ./periodic_sr &
-    PID=$!
-    
-    # Esperar o timeout
-    wait $PID 2>/dev/null
+    # Ejecución acotada: no se activan trabajos después de $length s y el
+    # programa termina solo, con el resumen final. El detector de deadlock
+    # lo termina antes con código 3 en cuanto se forma un ciclo de espera
+    ./periodic_sr -p $protocol -d abort -r $length
     EXIT_CODE=$?
     
-    if [ $EXIT_CODE -eq 124 ]; then
+    if [ $EXIT_CODE -eq 3 ]; then
         echo ""
-        echo "⏱️  Timeout alcanzado (${timeout}s)"
-        echo "   Esto puede indicar deadlock si PROTOCOL=NO"
+        echo "🔴 Deadlock detectado (ciclo en el grafo de espera, ver arriba)"
     elif [ $EXIT_CODE -eq 0 ]; then
         echo ""
-        echo "✓ Programa terminó normalmente"
+        echo "✓ Ejecución de ${length}s completada sin deadlock"
     else
         echo ""
         echo "⚠️  Programa terminó con código: $EXIT_CODE"
@@ -60,8 +57,8 @@ run_test() {
 
 # Menú interactivo
 echo "Selecciona el test a ejecutar:"
-echo "1) Test con PROTOCOL=NO  (observar deadlock - 10s timeout)"
-echo "2) Test con PROTOCOL=YES (evitar deadlock - 10s timeout)"
+echo "1) Test con -p none (observar deadlock - ejecución de 10s)"
+echo "2) Test con -p pcp  (evitar deadlock - ejecución de 10s)"
 echo "3) Ambos tests consecutivos"
 echo "4) Salir"
 echo ""
@@ -69,43 +66,24 @@ read -p "Opción [1-4]: " option
 
 case $option in
     1)
-        echo ""
-        echo "IMPORTANTE: Verifica que en periodic_sr.c:"
-        echo "  const protocol_usage PROTOCOL = NO;"
         echo ""
         read -p "¿Continuar? (s/n): " confirm
         if [ "$confirm" = "s" ]; then
-            run_test "NO" "10" "TEST 1: Sin Protocolo (Deadlock Esperado)"
+            run_test "none" "10" "TEST 1: Sin Protocolo (Deadlock Esperado)"
             echo "Si viste que el programa se quedó bloqueado, ¡eso es deadlock!"
         fi
         ;;
     2)
-        echo ""
-        echo "IMPORTANTE: Verifica que en periodic_sr.c:"
-        echo "  const protocol_usage PROTOCOL = YES;"
         echo ""
         read -p "¿Continuar? (s/n): " confirm
         if [ "$confirm" = "s" ]; then
-            run_test "YES" "10" "TEST 2: Con Protocolo (Sin Deadlock)"
+            run_test "pcp" "10" "TEST 2: Con Protocolo (Sin Deadlock)"
             echo "El programa debe ejecutarse sin bloqueos permanentes"
         fi
         ;;
     3)
-        echo ""
-        echo "NOTA: Tendrás que modificar PROTOCOL manualmente entre tests"
-        echo "      y recompilar con: gcc -o periodic_sr periodic_sr.c eat.c -lpthread -lrt"
-        echo ""
-        read -p "Press Enter para continuar..."
-        
-        echo ""
-        echo "1. Primero, configura PROTOCOL = NO y recompila"
-        read -p "Press Enter cuando esté listo..."
-        run_test "NO" "10" "TEST 1: Sin Protocolo"
-        
-        echo ""
-        echo "2. Ahora, configura PROTOCOL = YES y recompila"
-        read -p "Press Enter cuando esté listo..."
-        run_test "YES" "10" "TEST 2: Con Protocolo"
+        run_test "none" "10" "TEST 1: Sin Protocolo"
+        run_test "pcp" "10" "TEST 2: Con Protocolo"
         ;;
     4)
         echo "Saliendo..."
@@ -0,0 +1,291 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "trace.h"
+
+static struct trace_ring *rings;
+static int num_rings;
+static int64_t origin_ns;
+
+// Binary trace file: only the chunk being written is mapped
+static int file_fd = -1;
+static char *window;      // mapping of the current chunk, NULL if none
+static off_t window_off;  // file offset of the current chunk
+static size_t window_pos; // bytes used in the current chunk
+static int file_closed;   // the final flush has been done
+
+// Serializes the drainer thread and the at-exit flush (never taken by producers)
+static pthread_mutex_t drain_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Print one event in the same format used by the old report()
+void trace_print_event(const struct trace_event *e, int64_t origin)
+{
+  char message[64];
+  double t = (e->timestamp - origin) / 1.0e9;
+
+  switch (e->kind)
+  {
+  case TRACE_JOB_START:
+    strcpy(message, "Start thread ");
+    break;
+  case TRACE_LOCK_TRY:
+    sprintf(message, "Thread trying to lock R%d", e->resource);
+    break;
+  case TRACE_LOCK_ACQUIRED:
+    sprintf(message, "Thread acquired R%d", e->resource);
+    break;
+  case TRACE_LOCK_RELEASED:
+    sprintf(message, "Thread released R%d", e->resource);
+    break;
+  case TRACE_JOB_END:
+    strcpy(message, "End   thread ");
+    break;
+  case TRACE_WCRT:
+    strcpy(message, "Worst-case response time ");
+    break;
+  case TRACE_DEADLOCK:
+    sprintf(message, "Deadlock detected waiting for R%d", e->resource);
+    break;
+  case TRACE_DEADLINE_MISS:
+    strcpy(message, "Deadline missed by ");
+    break;
+  default:
+    sprintf(message, "Unknown event %d", e->kind);
+    break;
+  }
+
+  printf("%3.3f - %s - %d", t, message, e->task_id);
+  if (e->kind == TRACE_JOB_END || e->kind == TRACE_WCRT || e->kind == TRACE_DEADLINE_MISS)
+  {
+    printf(" - %3.3f\n", e->value / 1.0e9);
+  }
+  else
+  {
+    printf("\n");
+  }
+}
+
+// Map the next chunk of the trace file, growing the file to hold it
+static int next_window(void)
+{
+  if (window != NULL)
+  {
+    munmap(window, TRACE_FILE_CHUNK);
+    window_off += TRACE_FILE_CHUNK;
+  }
+  window = NULL;
+  if (ftruncate(file_fd, window_off + TRACE_FILE_CHUNK) != 0)
+    return -1;
+  window = mmap(NULL, TRACE_FILE_CHUNK, PROT_READ | PROT_WRITE, MAP_SHARED, file_fd,
+                window_off);
+  if (window == MAP_FAILED)
+  {
+    window = NULL;
+    return -1;
+  }
+  window_pos = 0;
+  return 0;
+}
+
+// Append n bytes to the trace file; records may straddle two chunks
+static void file_append(const void *p, size_t n)
+{
+  const char *c = p;
+
+  while (n > 0)
+  {
+    size_t k;
+
+    if ((window == NULL || window_pos == TRACE_FILE_CHUNK) && next_window() != 0)
+    {
+      perror("trace file");
+      return;
+    }
+    k = TRACE_FILE_CHUNK - window_pos < n ? TRACE_FILE_CHUNK - window_pos : n;
+    memcpy(window + window_pos, c, k);
+    window_pos += k;
+    c += k;
+    n -= k;
+  }
+}
+
+// Cut the file to the bytes written and close it
+static void file_close(void)
+{
+  off_t size = window_off + (off_t)window_pos;
+
+  if (window != NULL)
+    munmap(window, TRACE_FILE_CHUNK);
+  window = NULL;
+  if (ftruncate(file_fd, size) != 0)
+    perror("trace file");
+  close(file_fd);
+  file_fd = -1;
+  file_closed = 1;
+}
+
+int trace_open_file(const char *path)
+{
+  struct trace_file_header h;
+
+  file_fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (file_fd < 0)
+  {
+    perror(path);
+    return -1;
+  }
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, TRACE_FILE_MAGIC, sizeof(h.magic));
+  h.version = TRACE_FILE_VERSION;
+  h.event_size = sizeof(struct trace_event);
+  h.origin = origin_ns;
+  if (next_window() != 0)
+  {
+    perror(path);
+    return -1;
+  }
+  file_append(&h, sizeof(h));
+  return 0;
+}
+
+// Drain the events published so far, merging the rings by timestamp
+static void drain(void)
+{
+  uint64_t limit[num_rings];
+  uint64_t tail[num_rings];
+  int i, next;
+
+  for (i = 0; i < num_rings; i++)
+  {
+    limit[i] = atomic_load_explicit(&rings[i].head, memory_order_acquire);
+    tail[i] = atomic_load_explicit(&rings[i].tail, memory_order_relaxed);
+  }
+
+  while (1)
+  {
+    const struct trace_event *oldest = NULL;
+
+    next = -1;
+    for (i = 0; i < num_rings; i++)
+    {
+      const struct trace_event *e;
+
+      if (tail[i] == limit[i])
+      {
+        continue;
+      }
+      e = &rings[i].events[tail[i] & (TRACE_RING_CAPACITY - 1)];
+      if (oldest == NULL || e->timestamp < oldest->timestamp)
+      {
+        oldest = e;
+        next = i;
+      }
+    }
+    if (next < 0)
+    {
+      break;
+    }
+    if (file_fd >= 0)
+      file_append(oldest, sizeof(*oldest));
+    else if (!file_closed)
+      trace_print_event(oldest, origin_ns);
+    tail[next]++;
+    atomic_store_explicit(&rings[next].tail, tail[next], memory_order_release);
+  }
+  fflush(stdout);
+}
+
+// Body of the drainer thread: wake up periodically and format pending events
+static void *drainer(void *arg)
+{
+  struct timespec period = {0, TRACE_DRAIN_PERIOD_NS};
+
+  (void)arg;
+  while (1)
+  {
+    clock_nanosleep(CLOCK_MONOTONIC, 0, &period, NULL);
+    pthread_mutex_lock(&drain_lock);
+    drain();
+    pthread_mutex_unlock(&drain_lock);
+  }
+  return NULL;
+}
+
+int trace_init(int nrings, const struct timespec *origin)
+{
+  int i;
+
+  rings = aligned_alloc(64, nrings * sizeof(struct trace_ring));
+  if (rings == NULL)
+  {
+    return -1;
+  }
+  for (i = 0; i < nrings; i++)
+  {
+    atomic_init(&rings[i].head, 0);
+    atomic_init(&rings[i].tail, 0);
+    atomic_init(&rings[i].dropped, 0);
+    rings[i].events = calloc(TRACE_RING_CAPACITY, sizeof(struct trace_event));
+    if (rings[i].events == NULL)
+    {
+      return -1;
+    }
+  }
+  num_rings = nrings;
+  origin_ns = (int64_t)origin->tv_sec * 1000000000 + origin->tv_nsec;
+  atexit(trace_flush);
+  return 0;
+}
+
+struct trace_ring *trace_ring(int i)
+{
+  return &rings[i];
+}
+
+int trace_start_drainer(int prio)
+{
+  pthread_t th;
+  pthread_attr_t attr;
+  struct sched_param sch_param;
+  int err;
+
+  pthread_attr_init(&attr);
+  pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+  pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+  sch_param.sched_priority = prio;
+  pthread_attr_setschedparam(&attr, &sch_param);
+
+  err = pthread_create(&th, &attr, drainer, NULL);
+  pthread_attr_destroy(&attr);
+  return err;
+}
+
+void trace_flush(void)
+{
+  uint64_t lost = 0;
+  int i;
+
+  if (rings == NULL)
+  {
+    return;
+  }
+  pthread_mutex_lock(&drain_lock);
+  drain();
+  for (i = 0; i < num_rings; i++)
+  {
+    lost += atomic_load_explicit(&rings[i].dropped, memory_order_relaxed);
+  }
+  if (lost > 0)
+  {
+    printf("Trace: %llu events dropped (ring full)\n", (unsigned long long)lost);
+    fflush(stdout);
+  }
+  if (file_fd >= 0)
+    file_close();
+  pthread_mutex_unlock(&drain_lock);
+}
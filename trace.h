@@ -0,0 +1,118 @@
+#ifndef _TRACE_H
+#define _TRACE_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include <time.h>
+
+/**
+ * @file trace.h
+ *
+ * Per-thread trace buffers. Each periodic thread owns a single-producer
+ * ring of fixed-size binary events; a low-priority drainer thread (and an
+ * at-exit flush) formats them, or appends them to a compact binary file,
+ * so tracing inside a critical section costs one clock read and a few
+ * stores and never blocks on the stdout lock.
+ **/
+
+// Number of events per ring (must be a power of two)
+#define TRACE_RING_CAPACITY 4096
+
+// Period of the drainer thread, in nanoseconds
+#define TRACE_DRAIN_PERIOD_NS 100000000
+
+typedef enum
+{
+  TRACE_JOB_START,
+  TRACE_LOCK_TRY,
+  TRACE_LOCK_ACQUIRED,
+  TRACE_LOCK_RELEASED,
+  TRACE_JOB_END,
+  TRACE_WCRT,
+  TRACE_DEADLOCK,
+  TRACE_DEADLINE_MISS
+} trace_kind;
+
+// One binary trace event (24 bytes)
+struct trace_event
+{
+  int64_t timestamp; // CLOCK_MONOTONIC time, in nanoseconds
+  int64_t value;     // response time (JOB_END, WCRT) or lateness
+                     // (DEADLINE_MISS) in nanoseconds, else 0
+  int32_t task_id;   // thread identifier
+  int16_t resource;  // resource number (1 for R1, ...), 0 if none
+  uint8_t kind;      // one of trace_kind
+  uint8_t pad;
+};
+
+// Header of a binary trace file, followed by struct trace_event records in
+// timestamp order. The file grows in TRACE_FILE_CHUNK steps and is cut to
+// its real size on the final flush; after a crash it ends with zeroed
+// records (timestamp 0)
+struct trace_file_header
+{
+  char magic[8];       // TRACE_FILE_MAGIC
+  uint32_t version;    // TRACE_FILE_VERSION
+  uint32_t event_size; // sizeof(struct trace_event)
+  int64_t origin;      // CLOCK_MONOTONIC time of the start of the run, in ns
+};
+
+#define TRACE_FILE_MAGIC "PSRTRACE"
+#define TRACE_FILE_VERSION 1
+#define TRACE_FILE_CHUNK (4 << 20)
+
+// Single-producer/single-consumer ring. head and dropped are only written
+// by the owner thread and tail only by the drainer, each side on its own
+// cache line; events never changes after trace_init.
+struct trace_ring
+{
+  _Alignas(64) _Atomic uint64_t head;
+  _Atomic uint64_t dropped; // events lost because the ring was full
+  struct trace_event *events;
+  _Alignas(64) _Atomic uint64_t tail;
+};
+
+// Allocate nrings rings; timestamps are printed relative to origin
+extern int trace_init(int nrings, const struct timespec *origin);
+
+// Ring owned by thread number i (0 <= i < nrings)
+extern struct trace_ring *trace_ring(int i);
+
+// Write the events to a memory-mapped binary file instead of formatting
+// them to stdout (call after trace_init)
+extern int trace_open_file(const char *path);
+
+// Create the drainer thread with SCHED_FIFO priority prio
+extern int trace_start_drainer(int prio);
+
+// Format every pending event to stdout (or append them to the trace file,
+// which is then closed)
+extern void trace_flush(void);
+
+// Print one event to stdout, with its time relative to origin (ns)
+extern void trace_print_event(const struct trace_event *e, int64_t origin);
+
+// Record an event; never blocks, drops the event if the ring is full
+static inline void trace_emit(struct trace_ring *r, trace_kind kind, int id,
+                              int resource, int64_t value)
+{
+  struct timespec now;
+  struct trace_event *e;
+  uint64_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+
+  if (head - atomic_load_explicit(&r->tail, memory_order_acquire) >= TRACE_RING_CAPACITY)
+  {
+    atomic_fetch_add_explicit(&r->dropped, 1, memory_order_relaxed);
+    return;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  e = &r->events[head & (TRACE_RING_CAPACITY - 1)];
+  e->timestamp = (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+  e->value = value;
+  e->task_id = id;
+  e->resource = resource;
+  e->kind = kind;
+  atomic_store_explicit(&r->head, head + 1, memory_order_release);
+}
+
+#endif
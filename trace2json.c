@@ -0,0 +1,259 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "trace.h"
+
+/**
+ * Converts a binary trace written by periodic_sr -t into the Chrome
+ * trace-event JSON format, which chrome://tracing and ui.perfetto.dev
+ * open. Every task is a track with one span per job, nested spans for
+ * the time spent waiting for a resource ("wait R1") and for the time it
+ * is held ("R1"), and instant markers for missed deadlines and detected
+ * deadlocks. Spans still open at the end of the trace (e.g. the threads
+ * caught in a deadlock) are closed at the last event and marked as
+ * unfinished.
+ **/
+
+// Open spans of one task; the arrays are indexed by resource number
+struct task_track
+{
+  int id;
+  int64_t job;      // start of the current job, -1 if none
+  int nresources;
+  int64_t *waiting; // LOCK_TRY time, -1 if not waiting
+  int64_t *holding; // LOCK_ACQUIRED time, -1 if not held
+};
+
+static struct task_track *tracks;
+static int ntracks;
+static int64_t origin;
+static int first = 1;
+
+static void usage(const char *name)
+{
+  fprintf(stderr, "Usage: %s trace-file [json-file]\n", name);
+  exit(1);
+}
+
+// Start a new element of the traceEvents array
+static void separator(FILE *out)
+{
+  fprintf(out, first ? "\n" : ",\n");
+  first = 0;
+}
+
+// Microseconds since the start of the run, the unit of the format
+static double us(int64_t t)
+{
+  return (t - origin) / 1.0e3;
+}
+
+static struct task_track *track(FILE *out, int id)
+{
+  struct task_track *t;
+  int i;
+
+  for (i = 0; i < ntracks; i++)
+  {
+    if (tracks[i].id == id)
+      return &tracks[i];
+  }
+  tracks = realloc(tracks, (ntracks + 1) * sizeof(*tracks));
+  if (tracks == NULL)
+  {
+    perror("realloc");
+    exit(1);
+  }
+  t = &tracks[ntracks++];
+  memset(t, 0, sizeof(*t));
+  t->id = id;
+  t->job = -1;
+
+  separator(out);
+  fprintf(out, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+               "\"args\":{\"name\":\"Task %d\"}},\n", id, id);
+  fprintf(out, "{\"name\":\"thread_sort_index\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+               "\"args\":{\"sort_index\":%d}}", id, id);
+  return t;
+}
+
+// Make room for resource r in the span arrays of t
+static void grow(struct task_track *t, int r)
+{
+  int k;
+
+  if (r < t->nresources)
+    return;
+  t->waiting = realloc(t->waiting, (r + 1) * sizeof(int64_t));
+  t->holding = realloc(t->holding, (r + 1) * sizeof(int64_t));
+  if (t->waiting == NULL || t->holding == NULL)
+  {
+    perror("realloc");
+    exit(1);
+  }
+  for (k = t->nresources; k <= r; k++)
+    t->waiting[k] = t->holding[k] = -1;
+  t->nresources = r + 1;
+}
+
+// Complete event ("X") from start to end on the track of task id
+static void span(FILE *out, int id, const char *cat, const char *name, int64_t start,
+                 int64_t end, const char *args)
+{
+  separator(out);
+  fprintf(out, "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,"
+               "\"ts\":%.3f,\"dur\":%.3f%s%s%s}",
+          name, cat, id, us(start), (end - start) / 1.0e3, args != NULL ? ",\"args\":{" : "",
+          args != NULL ? args : "", args != NULL ? "}" : "");
+}
+
+static void instant(FILE *out, int id, const char *name, int64_t t, const char *args)
+{
+  separator(out);
+  fprintf(out, "{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":%d,"
+               "\"ts\":%.3f,\"args\":{%s}}",
+          name, id, us(t), args);
+}
+
+// Close every span still open on t at time end
+static void close_all(FILE *out, struct task_track *t, int64_t end)
+{
+  char name[32];
+  int k;
+
+  for (k = 0; k < t->nresources; k++)
+  {
+    if (t->waiting[k] >= 0)
+    {
+      sprintf(name, "wait R%d", k);
+      span(out, t->id, "blocking", name, t->waiting[k], end, "\"unfinished\":true");
+      t->waiting[k] = -1;
+    }
+    if (t->holding[k] >= 0)
+    {
+      sprintf(name, "R%d", k);
+      span(out, t->id, "lock", name, t->holding[k], end, "\"unfinished\":true");
+      t->holding[k] = -1;
+    }
+  }
+  if (t->job >= 0)
+  {
+    span(out, t->id, "job", "job", t->job, end, "\"unfinished\":true");
+    t->job = -1;
+  }
+}
+
+static void convert(FILE *out, const struct trace_event *e)
+{
+  struct task_track *t = track(out, e->task_id);
+  char name[32], args[64];
+  int r = e->resource;
+
+  if (r < 0)
+    r = 0;
+  grow(t, r);
+  switch (e->kind)
+  {
+  case TRACE_JOB_START:
+    // A job left unfinished by the previous one (aborted or recovered)
+    close_all(out, t, e->timestamp);
+    t->job = e->timestamp;
+    break;
+  case TRACE_LOCK_TRY:
+    t->waiting[r] = e->timestamp;
+    break;
+  case TRACE_LOCK_ACQUIRED:
+    if (t->waiting[r] >= 0 && e->timestamp > t->waiting[r])
+    {
+      sprintf(name, "wait R%d", r);
+      span(out, t->id, "blocking", name, t->waiting[r], e->timestamp, NULL);
+    }
+    t->waiting[r] = -1;
+    t->holding[r] = e->timestamp;
+    break;
+  case TRACE_LOCK_RELEASED:
+    if (t->holding[r] >= 0)
+    {
+      sprintf(name, "R%d", r);
+      span(out, t->id, "lock", name, t->holding[r], e->timestamp, NULL);
+    }
+    t->holding[r] = -1;
+    break;
+  case TRACE_JOB_END:
+    if (t->job >= 0)
+    {
+      sprintf(args, "\"response_ms\":%.3f", e->value / 1.0e6);
+      span(out, t->id, "job", "job", t->job, e->timestamp, args);
+    }
+    t->job = -1;
+    break;
+  case TRACE_DEADLINE_MISS:
+    sprintf(args, "\"lateness_ms\":%.3f", e->value / 1.0e6);
+    instant(out, t->id, "deadline miss", e->timestamp, args);
+    break;
+  case TRACE_DEADLOCK:
+    sprintf(args, "\"resource\":\"R%d\"", r);
+    instant(out, t->id, "deadlock", e->timestamp, args);
+    break;
+  default:
+    // TRACE_WCRT is implied by the job spans
+    break;
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  struct trace_file_header h;
+  struct trace_event e;
+  FILE *in, *out = stdout;
+  int64_t last = 0, events = 0;
+  int i;
+
+  if (argc < 2 || argc > 3)
+    usage(argv[0]);
+  if ((in = fopen(argv[1], "rb")) == NULL)
+  {
+    perror(argv[1]);
+    exit(1);
+  }
+  if (fread(&h, sizeof(h), 1, in) != 1 || memcmp(h.magic, TRACE_FILE_MAGIC, sizeof(h.magic)) != 0)
+  {
+    fprintf(stderr, "%s: not a periodic_sr trace file\n", argv[1]);
+    exit(1);
+  }
+  if (h.version != TRACE_FILE_VERSION || h.event_size != sizeof(struct trace_event))
+  {
+    fprintf(stderr, "%s: unsupported trace version %u (event size %u)\n", argv[1], h.version,
+            h.event_size);
+    exit(1);
+  }
+  if (argc == 3 && (out = fopen(argv[2], "w")) == NULL)
+  {
+    perror(argv[2]);
+    exit(1);
+  }
+  origin = h.origin;
+
+  fprintf(out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+  separator(out);
+  fprintf(out, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,"
+               "\"args\":{\"name\":\"periodic_sr\"}}");
+  // A zeroed record is the unwritten tail of a trace cut short by a crash
+  while (fread(&e, sizeof(e), 1, in) == 1 && e.timestamp != 0)
+  {
+    convert(out, &e);
+    last = e.timestamp;
+    events++;
+  }
+  for (i = 0; i < ntracks; i++)
+    close_all(out, &tracks[i], last);
+  fprintf(out, "\n]}\n");
+
+  fprintf(stderr, "%lld events, %d tasks, %.3f s\n", (long long)events, ntracks,
+          events > 0 ? (last - origin) / 1.0e9 : 0.0);
+  fclose(in);
+  if (out != stdout)
+    fclose(out);
+  return 0;
+}
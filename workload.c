@@ -0,0 +1,89 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include "workload.h"
+#include "stats.h"
+
+void workload_seed(struct task_set *ts, uint64_t seed)
+{
+  int i;
+
+  for (i = 0; i < ts->ntasks; i++)
+  {
+    uint64_t state = seed ^ ((uint64_t)ts->tasks[i].id * 0xd1b54a32d192ed03ULL);
+
+    // One step so that neighbouring ids do not start from related states
+    ts->tasks[i].rng = workload_next(&state);
+    ts->tasks[i].jobs = 0;
+  }
+}
+
+int workload_job(struct periodic_data *d)
+{
+  struct fault *f = d->fault;
+  int faulty;
+
+  d->jobs++;
+  if (f == NULL)
+    return 0;
+  faulty = f->every > 0 ? d->jobs % f->every == 0 : workload_uniform(&d->rng) < f->prob;
+  if (faulty)
+    stats_count(&f->injected, 1);
+  return faulty;
+}
+
+// 1 if d holds resource number r
+static int holds(const struct periodic_data *d, int r)
+{
+  int i;
+
+  for (i = 0; i < d->nheld; i++)
+  {
+    if (d->held[i] == r - 1)
+      return 1;
+  }
+  return 0;
+}
+
+struct timespec workload_time(struct periodic_data *d, const struct segment *s, int faulty)
+{
+  const struct exec_dist *dist = d->dists[s - d->segments];
+  int64_t wcet = (int64_t)s->time.tv_sec * 1000000000 + s->time.tv_nsec, t;
+  struct timespec ts;
+
+  if (faulty && (d->fault->resource == 0 || holds(d, d->fault->resource)))
+    t = (int64_t)(wcet * d->fault->scale);
+  else if (dist == NULL)
+    return s->time;
+  else if (dist->kind == EXEC_UNIFORM)
+    t = dist->low + (int64_t)(workload_uniform(&d->rng) * (wcet - dist->low));
+  else if (dist->kind == EXEC_BIMODAL)
+    t = workload_uniform(&d->rng) < dist->p ? wcet : dist->low;
+  else
+    t = dist->samples[(int)(workload_uniform(&d->rng) * dist->nsamples)];
+
+  ts.tv_sec = t / 1000000000;
+  ts.tv_nsec = t % 1000000000;
+  return ts;
+}
+
+void workload_print_faults(FILE *f, const struct task_set *ts)
+{
+  int i, header = 0;
+
+  for (i = 0; i < ts->ntasks; i++)
+  {
+    const struct periodic_data *d = &ts->tasks[i];
+
+    if (d->fault == NULL)
+      continue;
+    if (!header)
+      fprintf(f, "Injected faults:\n  Task     Jobs   Faulty  Scale  Segments\n");
+    header = 1;
+    fprintf(f, "  %4d %8llu %8llu %6.2f  ", d->id, (unsigned long long)d->jobs,
+            (unsigned long long)atomic_load(&d->fault->injected), d->fault->scale);
+    if (d->fault->resource > 0)
+      fprintf(f, "inside R%d\n", d->fault->resource);
+    else
+      fprintf(f, "all\n");
+  }
+}
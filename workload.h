@@ -0,0 +1,51 @@
+#ifndef _WORKLOAD_H
+#define _WORKLOAD_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include "taskset.h"
+
+/**
+ * @file workload.h
+ *
+ * Execution times of the jobs. A compute segment with a distribution
+ * (see exec_kind) draws its time from the random stream of its task, a
+ * splitmix64 generator seeded from a run seed and the task id: each task
+ * owns its state, so drawing takes no lock and a given seed repeats the
+ * same times whatever the scheduling. A job chosen by the fault of its
+ * task runs the affected segments for scale times their WCET instead.
+ * The analysis and the simulator always use the WCET.
+ **/
+
+// splitmix64 step: reproducible for a given seed on every platform
+static inline uint64_t workload_next(uint64_t *state)
+{
+  uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+// Uniform in [0, 1)
+static inline double workload_uniform(uint64_t *state)
+{
+  return (workload_next(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// Seed the stream of every task of ts from seed
+extern void workload_seed(struct task_set *ts, uint64_t seed);
+
+// Start a new job of d: 1 if its fault hits this job
+extern int workload_job(struct periodic_data *d);
+
+// Time compute segment s of the current job of d takes; faulty is what
+// workload_job returned for the job
+extern struct timespec workload_time(struct periodic_data *d, const struct segment *s,
+                                     int faulty);
+
+// Print the faults injected in every task
+extern void workload_print_faults(FILE *f, const struct task_set *ts);
+
+#endif